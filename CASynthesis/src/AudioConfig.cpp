@@ -0,0 +1,87 @@
+//
+//  AudioConfig.cpp
+//  CASynthesis
+//
+//
+
+#include "AudioConfig.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+
+static std::string trim(const std::string& text)
+{
+    const char* space = " \t\r\n";
+    size_t first = text.find_first_not_of(space);
+    if (first == std::string::npos)
+        return "";
+    return text.substr(first, text.find_last_not_of(space) - first + 1);
+}
+
+static bool parseFlag(const std::string& value)
+{
+    return value == "1" || value == "true" || value == "yes" || value == "on";
+}
+
+AudioConfig::AudioConfig()
+{
+    sampleRate = 0;
+    framesPerBlock = 0;
+    measureLatency = false;
+    listDevices = false;
+}
+
+bool AudioConfig::load(const std::string& path, std::string* errors)
+{
+    std::ifstream file(path.c_str());
+    if (!file)
+        return false;
+
+    std::string line;
+    for (int number = 1; std::getline(file, line); ++number)
+    {
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty())
+            continue;
+
+        size_t equals = line.find('=');
+        // a line without '=' has no key and ends up reported below
+        std::string key = (equals != std::string::npos) ? trim(line.substr(0, equals)) : "";
+        std::string value = (equals != std::string::npos) ? trim(line.substr(equals + 1)) : "";
+
+        if (key == "output_device")
+            outputDevice = value;
+        else if (key == "input_device")
+            inputDevice = value;
+        else if (key == "sample_rate")
+            sampleRate = std::max(0, atoi(value.c_str()));
+        else if (key == "frames_per_block")
+            framesPerBlock = std::max(0, atoi(value.c_str()));
+        else if (key == "measure_latency")
+            measureLatency = parseFlag(value);
+        else if (errors != NULL)
+            *errors += path + ":" + std::to_string(number) + ": cannot read \"" + line + "\"\n";
+    }
+    return true;
+}
+
+void AudioConfig::parse(const std::vector<std::string>& args)
+{
+    for (size_t k = 0; k < args.size(); ++k)
+    {
+        const bool hasValue = (k + 1 < args.size());
+        if (args[k] == "--device" && hasValue)
+            outputDevice = args[++k];
+        else if (args[k] == "--input-device" && hasValue)
+            inputDevice = args[++k];
+        else if (args[k] == "--rate" && hasValue)
+            sampleRate = std::max(0, atoi(args[++k].c_str()));
+        else if (args[k] == "--block" && hasValue)
+            framesPerBlock = std::max(0, atoi(args[++k].c_str()));
+        else if (args[k] == "--measure-latency")
+            measureLatency = true;
+        else if (args[k] == "--list-devices")
+            listDevices = true;
+    }
+}
@@ -0,0 +1,34 @@
+//
+//  AudioConfig.h
+//  CASynthesis
+//
+//
+
+#ifndef AudioConfig_h
+#define AudioConfig_h
+
+#include <string>
+#include <vector>
+
+// Audio device settings, read from a file and then overridden from the command line. The file holds
+// "key = value" lines, '#' starting a comment, with the keys output_device, input_device, sample_rate,
+// frames_per_block and measure_latency. Empty device names and zero numbers leave the device's own defaults.
+struct AudioConfig
+{
+    std::string outputDevice;
+    std::string inputDevice;
+    int sampleRate;
+    int framesPerBlock;
+    bool measureLatency;
+    bool listDevices;
+
+    AudioConfig();
+
+    //! false if \a path cannot be read; unknown keys and malformed lines are reported in \a errors and skipped
+    bool load(const std::string& path, std::string* errors = NULL);
+
+    //! --device name, --input-device name, --rate hz, --block frames, --measure-latency and --list-devices
+    void parse(const std::vector<std::string>& args);
+};
+
+#endif /* AudioConfig_h */
@@ -0,0 +1,105 @@
+//
+//  AutomatonNode.cpp
+//  CASynthesis
+//
+//
+
+#include "AutomatonNode.h"
+#include "RealtimeGuard.h"
+
+#include "cinder/audio/Context.h"
+
+#include <algorithm>
+
+using namespace ci;
+
+AutomatonNode::AutomatonNode(int gridSize, size_t stepFrames, const Format& format)
+: InputNode(format), mKernel(gridSize), mBank(gridSize * gridSize), mStepFrames(std::max<size_t>(1, stepFrames))
+{
+    if (getChannelMode() != ChannelMode::SPECIFIED)
+    {
+        setChannelMode(ChannelMode::SPECIFIED);
+        setNumChannels(2);
+    }
+
+    mFramesUntilStep = 0;
+}
+
+void AutomatonNode::initialize()
+{
+    mBank.setSampleRate(getSampleRate());
+}
+
+void AutomatonNode::seed(const CAKernel& source)
+{
+    std::lock_guard<std::mutex> lock(getContext()->getMutex());
+
+    int size = std::min(source.getSize(), mKernel.getSize());
+    mKernel.clear();
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < size; ++j)
+            mKernel.setCell(i, j, source.getAmp(i, j), source.getFreq(i, j));
+}
+
+size_t AutomatonNode::getStepFrames() const
+{
+    return mStepFrames;
+}
+
+void AutomatonNode::setStepFrames(size_t stepFrames)
+{
+    mStepFrames = std::max<size_t>(1, stepFrames);
+}
+
+void AutomatonNode::updateVoices()
+{
+    // gains glide over a whole generation, which keeps kHz stepping free of clicks; only silent
+    // cells ever change frequency, so frequencies can jump
+    const float* amps = mKernel.getAmps();
+    const float* freqs = mKernel.getFreqs();
+    const float norm = 1.0f / mKernel.getCellsCount();
+
+    VoiceEvent event;
+    event.frame = mBank.getFrame();
+    event.rampFrames = (uint32_t)mFramesUntilStep;
+    for (int v = 0; v < mKernel.getCellsCount(); ++v)
+    {
+        event.cell = v;
+
+        event.type = VoiceEvent::FREQ;
+        event.value = freqs[v];
+        mBank.apply(event);
+
+        event.type = VoiceEvent::GAIN;
+        event.value = amps[v] * norm;
+        mBank.apply(event);
+    }
+}
+
+void AutomatonNode::process(audio::Buffer* buffer)
+{
+    RealtimeGuard::Scope realtime;
+
+    float* left = buffer->getChannel(0);
+    float* right = buffer->getChannel(1);
+    const size_t numFrames = buffer->getNumFrames();
+
+    buffer->zero();
+
+    size_t frame = 0;
+    while (frame < numFrames)
+    {
+        if (mFramesUntilStep == 0)
+        {
+            mKernel.step();
+            mFramesUntilStep = mStepFrames;
+            updateVoices();
+        }
+
+        size_t segment = std::min(numFrames - frame, mFramesUntilStep);
+        mBank.render(left + frame, right + frame, segment);
+
+        frame += segment;
+        mFramesUntilStep -= segment;
+    }
+}
@@ -0,0 +1,46 @@
+//
+//  AutomatonNode.h
+//  CASynthesis
+//
+//
+
+#ifndef AutomatonNode_h
+#define AutomatonNode_h
+
+#include "cinder/audio/Node.h"
+#include "cinder/audio/InputNode.h"
+
+#include "CAKernel.h"
+#include "OscillatorBank.h"
+
+#include <atomic>
+
+typedef std::shared_ptr<class AutomatonNode> AutomatonNodeRef;
+
+// Runs a small automaton at control rate inside the audio graph: the grid advances every
+// stepFrames samples and its amplitudes drive one bank voice per cell directly.
+class AutomatonNode : public ci::audio::InputNode
+{
+protected:
+    CAKernel mKernel;
+    OscillatorBank mBank;
+
+    std::atomic<size_t> mStepFrames;
+    size_t mFramesUntilStep;
+
+    void initialize() override;
+    void process(ci::audio::Buffer* buffer) override;
+
+    void updateVoices();
+
+public:
+    AutomatonNode(int gridSize, size_t stepFrames, const Format& format = Format());
+
+    //! copies the top left corner of \a source into the node's grid
+    void seed(const CAKernel& source);
+
+    size_t getStepFrames() const;
+    void setStepFrames(size_t stepFrames);
+};
+
+#endif /* AutomatonNode_h */
@@ -0,0 +1,476 @@
+//
+//  CAKernel.cpp
+//  CASynthesis
+//
+//
+
+#include "CAKernel.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+CARule::CARule()
+{
+    radius = 1;
+    spectralNeighbors = 0;
+
+    birthCenter = 2.0;//1.9;
+    birthRadius = 0.37;//0.33;
+    keepCenter = 1.84;//1.9;
+    keepRadius = 0.35;//0.39;
+    delta = 0.07;//0.021;
+
+    lowestFreq = 20.0;
+    highestFreq = 20000.0;
+}
+
+CAStats::CAStats()
+{
+    reset();
+}
+
+void CAStats::reset()
+{
+    population = 0;
+    births = 0;
+    deaths = 0;
+    ampSum = 0.0;
+    ampSquaredSum = 0.0;
+    memset(histogram, 0, sizeof(histogram));
+}
+
+void CAStats::merge(const CAStats& other)
+{
+    population += other.population;
+    births += other.births;
+    deaths += other.deaths;
+    ampSum += other.ampSum;
+    ampSquaredSum += other.ampSquaredSum;
+    for (int k = 0; k < HISTOGRAM_BINS; ++k)
+        histogram[k] += other.histogram[k];
+}
+
+double CAStats::getMeanAmp() const
+{
+    return population > 0 ? ampSum / population : 0.0;
+}
+
+CAKernel::CAKernel(int size, const CARule& rule)
+{
+    mSize = 0;
+    mCurrent = 0;
+    mAmpSquaredSum = 0.0;
+    mRule = rule;
+    mBandsCount = 0;
+    mStepThreadCount = 1;
+
+    setThreadCount(1);
+
+    resize(size);
+}
+
+void CAKernel::resize(int size)
+{
+    mSize = size;
+    for (int k = 0; k < 2; ++k)
+    {
+        mAmp[k].assign(size * size, 0.0f);
+        mFreq[k].assign(size * size, 0.0f);
+    }
+    mCurrent = 0;
+    mAmpSquaredSum = 0.0;
+
+    updateWrap();
+    updateSpectralIndex();
+}
+
+int CAKernel::getSize() const
+{
+    return mSize;
+}
+
+int CAKernel::getCellsCount() const
+{
+    return mSize * mSize;
+}
+
+const CARule& CAKernel::getRule() const
+{
+    return mRule;
+}
+
+void CAKernel::setRule(const CARule& rule)
+{
+    mRule = rule;
+
+    updateWrap();
+    updateSpectralIndex();
+    updateBands();
+}
+
+void CAKernel::updateWrap()
+{
+    int radius = mRule.radius;
+    mWrap.resize(mSize + 2 * radius);
+    if (mSize == 0)
+        return;
+
+    for (int k = -radius; k < mSize + radius; ++k)
+        mWrap[k + radius] = ((k % mSize) + mSize) % mSize;
+}
+
+void CAKernel::updateSpectralIndex()
+{
+    if (mRule.spectralNeighbors > 0)
+        mSpectralIndex.reset(getFreqs(), getCellsCount(), mRule.lowestFreq, mRule.highestFreq);
+}
+
+void CAKernel::setThreadCount(int threadCount)
+{
+    mThreadCount = std::max(threadCount, 1);
+    mWorkers.resize(mThreadCount);
+    mSlots.resize(mThreadCount);
+    for (int k = 0; k < mThreadCount; ++k)
+    {
+        mSlots[k].randomState = 0x9E3779B9 + 0x6D2B79F5 * k;
+        mSlots[k].bandPower.assign(mBandsCount, 0.0f);
+        mSlots[k].bandPitch.assign(mBandsCount, 0.0f);
+    }
+}
+
+int CAKernel::getThreadCount() const
+{
+    return mThreadCount;
+}
+
+void CAKernel::setBandsCount(int bandsCount)
+{
+    mBandsCount = std::max(bandsCount, 0);
+    for (int k = 0; k < mThreadCount; ++k)
+    {
+        mSlots[k].bandPower.assign(mBandsCount, 0.0f);
+        mSlots[k].bandPitch.assign(mBandsCount, 0.0f);
+    }
+    mBandAmp.assign(mBandsCount, 0.0f);
+    mBandFreq.resize(mBandsCount);
+    updateBands();
+}
+
+int CAKernel::getBandsCount() const
+{
+    return mBandsCount;
+}
+
+const float* CAKernel::getBandAmps() const
+{
+    return mBandAmp.data();
+}
+
+const float* CAKernel::getBandFreqs() const
+{
+    return mBandFreq.data();
+}
+
+void CAKernel::updateBands()
+{
+    // bands start out at their centres
+    const float lowest = log2f(mRule.lowestFreq);
+    const float width = (log2f(mRule.highestFreq) - lowest) / std::max(mBandsCount, 1);
+    for (int band = 0; band < mBandsCount; ++band)
+        mBandFreq[band] = exp2f(lowest + (band + 0.5f) * width);
+}
+
+void CAKernel::mergeBands(int threadCount)
+{
+    for (int band = 0; band < mBandsCount; ++band)
+    {
+        float power = 0.0f;
+        float pitch = 0.0f;
+        for (int k = 0; k < threadCount; ++k)
+        {
+            power += mSlots[k].bandPower[band];
+            pitch += mSlots[k].bandPitch[band];
+        }
+
+        mBandAmp[band] = sqrtf(power);
+        if (power > 0.0f)
+            mBandFreq[band] = exp2f(pitch / power);
+    }
+}
+
+float CAKernel::randFreq(uint32_t& state)
+{
+    // xorshift32, rand() takes a lock on some platforms
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+
+    float random = (state >> 8) * (1.0f / 16777216.0f);
+    float lowest = log2f(mRule.lowestFreq);
+    float highest = log2f(mRule.highestFreq);
+    return exp2f(lowest + (highest - lowest) * random);
+}
+
+int CAKernel::getIndex(int i, int j) const
+{
+    return i * mSize + j;
+}
+
+float CAKernel::getAmp(int i, int j) const
+{
+    return mAmp[mCurrent][getIndex(i, j)];
+}
+
+float CAKernel::getFreq(int i, int j) const
+{
+    return mFreq[mCurrent][getIndex(i, j)];
+}
+
+const float* CAKernel::getAmps() const
+{
+    return mAmp[mCurrent].data();
+}
+
+const float* CAKernel::getFreqs() const
+{
+    return mFreq[mCurrent].data();
+}
+
+void CAKernel::setCell(int i, int j, float amp, float freq)
+{
+    int index = getIndex(i, j);
+    float previous = mAmp[mCurrent][index];
+    mAmp[mCurrent][index] = std::min(std::max(amp, 0.0f), 1.0f);
+    mFreq[mCurrent][index] = freq;
+    mAmpSquaredSum = std::max(0.0, mAmpSquaredSum + mAmp[mCurrent][index] * mAmp[mCurrent][index] - previous * previous);
+
+    if (mRule.spectralNeighbors > 0)
+        mSpectralIndex.update(index, freq);
+}
+
+void CAKernel::clear()
+{
+    std::fill(mAmp[mCurrent].begin(), mAmp[mCurrent].end(), 0.0f);
+    mAmpSquaredSum = 0.0;
+}
+
+void CAKernel::seedPartial(float freq, float amp)
+{
+    if (freq < mRule.lowestFreq || freq > mRule.highestFreq || getCellsCount() == 0)
+        return;
+
+    // neighbouring cells in a row hold neighbouring frequencies, so a partial lands among its own register
+    float position = log2f(freq / mRule.lowestFreq) / log2f(mRule.highestFreq / mRule.lowestFreq);
+    int index = std::min((int)(position * getCellsCount()), getCellsCount() - 1);
+    int i = index / mSize;
+    int j = index % mSize;
+    setCell(i, j, std::max(amp, mAmp[mCurrent][index]), freq);
+}
+
+float CAKernel::evaluate(const float* amp, int i, int j) const
+{
+    const int radius = mRule.radius;
+    const int* wrap = mWrap.data() + radius;
+    const int index = i * mSize + j;
+    const float state = amp[index];
+
+    float neighborsSum = -state;
+    if (mRule.spectralNeighbors > 0)
+    {
+        int neighbors[SpectralIndex::MAX_NEIGHBORS];
+        int count = mSpectralIndex.getNearest(index, mRule.spectralNeighbors, neighbors);
+
+        neighborsSum = 0.0f;
+        for (int n = 0; n < count; ++n)
+            neighborsSum += amp[neighbors[n]];
+        if (count > 0)
+            neighborsSum *= (float)getSpatialNeighborhoodSize() / count;
+    }
+    else
+    {
+        for (int ni = -radius; ni <= radius; ++ni)
+        {
+            const float* row = amp + wrap[i + ni] * mSize;
+            for (int nj = -radius; nj <= radius; ++nj)
+                neighborsSum += row[wrap[j + nj]];
+        }
+    }
+
+    float delta = -1.0f;
+    if (neighborsSum >= mRule.birthCenter - mRule.birthRadius && neighborsSum <= mRule.birthCenter + mRule.birthRadius)
+        delta = 1.0f;
+    else if (neighborsSum >= mRule.keepCenter - mRule.keepRadius && neighborsSum <= mRule.keepCenter + mRule.keepRadius)
+        delta = 0.0f;
+
+    return std::min(std::max(state + delta * mRule.delta, 0.0f), 1.0f);
+}
+
+void CAKernel::stepRows(int begin, int end, Slot& slot)
+{
+    const float* amp = mAmp[mCurrent].data();
+    const float* freq = mFreq[mCurrent].data();
+    float* nextAmp = mAmp[1 - mCurrent].data();
+    float* nextFreq = mFreq[1 - mCurrent].data();
+
+    const float lowest = log2f(mRule.lowestFreq);
+    const float binScale = CAStats::HISTOGRAM_BINS / (log2f(mRule.highestFreq) - lowest);
+    const float bandScale = mBandsCount / (log2f(mRule.highestFreq) - lowest);
+
+    CAStats& stats = slot.stats;
+    stats.reset();
+
+    // bands sum power and power weighted log frequency, so the band's partial lands where its loudest cells are
+    float* bandPower = slot.bandPower.data();
+    float* bandPitch = slot.bandPitch.data();
+    std::fill(bandPower, bandPower + mBandsCount, 0.0f);
+    std::fill(bandPitch, bandPitch + mBandsCount, 0.0f);
+
+    for (int i = begin; i < end; ++i)
+    {
+        for (int j = 0; j < mSize; ++j)
+        {
+            int index = i * mSize + j;
+            float state = amp[index];
+
+            float cellFreq = (state == 0.0f) ? randFreq(slot.randomState) : freq[index];
+            float cellAmp = evaluate(amp, i, j);
+            nextFreq[index] = cellFreq;
+            nextAmp[index] = cellAmp;
+
+            if (cellAmp > 0.0f)
+            {
+                stats.population++;
+                stats.ampSum += cellAmp;
+                stats.ampSquaredSum += cellAmp * cellAmp;
+
+                // a cell at 0 Hz has no pitch, and casting log2f(0) to a bin would be undefined
+                const float pitch = log2f(std::max(cellFreq, mRule.lowestFreq));
+                int bin = (int)((pitch - lowest) * binScale);
+                stats.histogram[std::min(std::max(bin, 0), CAStats::HISTOGRAM_BINS - 1)]++;
+
+                if (mBandsCount > 0)
+                {
+                    const float power = cellAmp * cellAmp;
+                    const int band = std::min(std::max((int)((pitch - lowest) * bandScale), 0), mBandsCount - 1);
+                    bandPower[band] += power;
+                    bandPitch[band] += power * pitch;
+                }
+
+                if (state == 0.0f)
+                    stats.births++;
+            }
+            else if (state > 0.0f)
+            {
+                stats.deaths++;
+            }
+        }
+    }
+}
+
+void CAKernel::stepRowsJob(void* kernel, int index)
+{
+    CAKernel* self = static_cast<CAKernel*>(kernel);
+    if (index < self->mStepThreadCount)
+        self->stepRows(self->mSize * index / self->mStepThreadCount, self->mSize * (index + 1) / self->mStepThreadCount,
+                       self->mSlots[index]);
+}
+
+void CAKernel::step()
+{
+    if (mRule.spectralNeighbors > 0)
+        mSpectralIndex.commit();
+
+    int threadCount = (getCellsCount() >= PARALLEL_MIN_CELLS) ? std::min(mThreadCount, mSize) : 1;
+
+    if (threadCount == 1)
+    {
+        stepRows(0, mSize, mSlots[0]);
+    }
+    else
+    {
+        mStepThreadCount = threadCount;
+        mWorkers.run(&CAKernel::stepRowsJob, this);
+    }
+
+    mStats = mSlots[0].stats;
+    for (int k = 1; k < threadCount; ++k)
+        mStats.merge(mSlots[k].stats);
+
+    mergeBands(threadCount);
+    mCurrent = 1 - mCurrent;
+    mAmpSquaredSum = mStats.ampSquaredSum;
+
+    // only cells that were dead change frequency
+    if (mRule.spectralNeighbors > 0)
+    {
+        const float* freq = mFreq[mCurrent].data();
+        const float* previousFreq = mFreq[1 - mCurrent].data();
+        for (int index = 0; index < getCellsCount(); ++index)
+            if (freq[index] != previousFreq[index])
+                mSpectralIndex.update(index, freq[index]);
+    }
+}
+
+const CAStats& CAKernel::getStats() const
+{
+    return mStats;
+}
+
+double CAKernel::getAmpSquaredSum() const
+{
+    return mAmpSquaredSum;
+}
+
+bool CAKernel::updateCell(int i, int j)
+{
+    int index = getIndex(i, j);
+    float* amp = mAmp[mCurrent].data();
+    float state = amp[index];
+
+    if (state == 0.0f)
+    {
+        mFreq[mCurrent][index] = randFreq(mSlots[0].randomState);
+        if (mRule.spectralNeighbors > 0)
+            mSpectralIndex.update(index, mFreq[mCurrent][index]);
+    }
+    if (mRule.spectralNeighbors > 0)
+        mSpectralIndex.commit();
+
+    // asynchronous updates see their neighbours as they are right now, not as a generation
+    amp[index] = evaluate(amp, i, j);
+    mAmpSquaredSum = std::max(0.0, mAmpSquaredSum + amp[index] * amp[index] - state * state);
+    return amp[index] != state;
+}
+
+int CAKernel::getSpatialNeighborhoodSize() const
+{
+    int side = 2 * mRule.radius + 1;
+    return side * side - 1;
+}
+
+int CAKernel::getNeighborhoodSize() const
+{
+    if (mRule.spectralNeighbors > 0)
+        return std::min(mRule.spectralNeighbors, (int)SpectralIndex::MAX_NEIGHBORS);
+    return getSpatialNeighborhoodSize();
+}
+
+int CAKernel::getNeighbors(int i, int j, int* out)
+{
+    if (mRule.spectralNeighbors > 0)
+    {
+        mSpectralIndex.commit();
+        return mSpectralIndex.getNearest(getIndex(i, j), mRule.spectralNeighbors, out);
+    }
+
+    const int radius = mRule.radius;
+    const int* wrap = mWrap.data() + radius;
+
+    int count = 0;
+    for (int ni = -radius; ni <= radius; ++ni)
+        for (int nj = -radius; nj <= radius; ++nj)
+            if (ni != 0 || nj != 0)
+                out[count++] = wrap[i + ni] * mSize + wrap[j + nj];
+    return count;
+}
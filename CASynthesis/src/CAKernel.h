@@ -0,0 +1,160 @@
+//
+//  CAKernel.h
+//  CASynthesis
+//
+//
+
+#ifndef CAKernel_h
+#define CAKernel_h
+
+#include <stdint.h>
+#include <vector>
+
+#include "SpectralIndex.h"
+#include "WorkerPool.h"
+
+struct CARule
+{
+    int radius;
+
+    // when positive, a cell's neighbours are the cells nearest to it in log frequency instead of its spatial
+    // neighbours; the sum is rescaled to the spatial neighbourhood size so the thresholds below keep their meaning
+    int spectralNeighbors;
+
+    float birthCenter;
+    float birthRadius;
+    float keepCenter;
+    float keepRadius;
+    float delta;
+
+    float lowestFreq;
+    float highestFreq;
+
+    CARule();
+};
+
+// Per generation statistics, accumulated by the step kernel during its sweep
+struct CAStats
+{
+    static const int HISTOGRAM_BINS = 32;
+
+    int population;
+    int births;
+    int deaths;
+    double ampSum;
+    double ampSquaredSum;
+
+    // live cells per log frequency bin between the rule's lowest and highest frequencies
+    int histogram[HISTOGRAM_BINS];
+
+    CAStats();
+
+    void reset();
+    void merge(const CAStats& other);
+
+    double getMeanAmp() const;
+};
+
+// Flat, double buffered grid stepping. Everything is allocated in resize(), setRule() and setThreadCount(),
+// so a single threaded step() is allocation and lock free and may be called from an audio callback.
+class CAKernel
+{
+protected:
+    // one reduction slot and random generator per thread, padded so that slots never share a cache line
+    struct Slot
+    {
+        CAStats stats;
+        uint32_t randomState;
+        std::vector<float> bandPower;
+        std::vector<float> bandPitch;
+        char padding[64];
+    };
+
+    int mSize;
+    CARule mRule;
+
+    std::vector<float> mAmp[2];
+    std::vector<float> mFreq[2];
+    int mCurrent;
+    double mAmpSquaredSum;
+
+    // cycled index for every position from -radius to size + radius - 1
+    std::vector<int> mWrap;
+
+    SpectralIndex mSpectralIndex;
+
+    int mThreadCount;
+    // threads taking part in the step in progress, at most mThreadCount
+    int mStepThreadCount;
+    WorkerPool mWorkers;
+    std::vector<Slot> mSlots;
+    CAStats mStats;
+
+    int mBandsCount;
+    std::vector<float> mBandAmp;
+    std::vector<float> mBandFreq;
+
+    void updateWrap();
+    void updateBands();
+    void mergeBands(int threadCount);
+    void updateSpectralIndex();
+    int getSpatialNeighborhoodSize() const;
+    float randFreq(uint32_t& state);
+    float evaluate(const float* amp, int i, int j) const;
+    void stepRows(int begin, int end, Slot& slot);
+    static void stepRowsJob(void* kernel, int index);
+
+public:
+    CAKernel(int size = 0, const CARule& rule = CARule());
+
+    void resize(int size);
+    int getSize() const;
+    int getCellsCount() const;
+
+    const CARule& getRule() const;
+    void setRule(const CARule& rule);
+
+    int getIndex(int i, int j) const;
+
+    float getAmp(int i, int j) const;
+    float getFreq(int i, int j) const;
+    const float* getAmps() const;
+    const float* getFreqs() const;
+
+    void setCell(int i, int j, float amp, float freq);
+    void clear();
+
+    //! sounds \a freq in the cell whose place in index order matches the frequency's log position between the
+    //! rule's lowest and highest frequencies, at \a amp or its own amplitude if that is louder
+    void seedPartial(float freq, float amp);
+
+    //! rows are split between \a threadCount threads once the grid has at least PARALLEL_MIN_CELLS cells
+    void setThreadCount(int threadCount);
+    int getThreadCount() const;
+
+    static const int PARALLEL_MIN_CELLS = 64 * 64;
+
+    void step();
+    const CAStats& getStats() const;
+    //! the live cells' summed squared amplitudes as they are now; unlike getStats() it follows setCell(),
+    //! seedPartial(), clear() and updateCell() as well as step()
+    double getAmpSquaredSum() const;
+
+    //! step() also sums the live cells into \a bandsCount bands, evenly spaced in log frequency between the rule's
+    //! lowest and highest frequencies; 0 turns it off. Allocates, so not from the audio thread.
+    void setBandsCount(int bandsCount);
+    int getBandsCount() const;
+
+    //! per band root of the summed squared amplitudes, the level of that many unrelated partials heard together
+    const float* getBandAmps() const;
+    //! per band power weighted mean frequency; an empty band keeps the last one it had
+    const float* getBandFreqs() const;
+
+    //! updates a single cell in place, returns whether its amplitude changed
+    bool updateCell(int i, int j);
+
+    int getNeighborhoodSize() const;
+    int getNeighbors(int i, int j, int* out);
+};
+
+#endif /* CAKernel_h */
@@ -5,7 +5,18 @@
 #include "cinder/Timeline.h"
 #include "cinder/audio/audio.h"
 
+#include <thread>
+#include <fstream>
+
 #include "Cell.h"
+#include "CAKernel.h"
+#include "CalendarQueue.h"
+#include "AutomatonNode.h"
+#include "OscillatorBankNode.h"
+#include "PeakTrackerNode.h"
+#include "LatencyProbeNode.h"
+#include "AudioConfig.h"
+#include "FastSine.h"
 #include "Defines.h"
 
 using namespace ci;
@@ -37,23 +48,55 @@ protected:
     
     bool mSoundEnabled;
     double mBase;
-    double mStepTimer;
+    bool mTranspositionGlide;
+    uint64_t mNextStepFrame;
     
     int mRuleRadius;
     double mRuleValues[RULE_VALUES_COUNT];
     
     int mGridSize;
+    bool mShowStats;
     double mLifePower;
     Cell*** mGrid;
+    CAKernel mKernel;
+    
+    bool mAsyncEnabled;
+    CalendarQueue mQueue;
+    std::vector<int> mDueCells;
+    std::vector<int> mNeighbors;
+    
+    OscillatorBankNodeRef mBankNode;
+    AutomatonNodeRef mAutomatonNode;
+    audio::InputDeviceNodeRef mInputNode;
+    PeakTrackerNodeRef mPeakTrackerNode;
+    bool mInputSeeding;
+    AudioConfig mAudioConfig;
+    audio::DeviceRef mOutputDevice;
+    LatencyProbeNodeRef mLatencyProbeNode;
     
     void shuffle();
     void clear();
     void updateBase();
+    void setWave(int wave);
+    void updateAutomatonWave();
+    void exportRenderStats();
     void modifyCell(ivec2 gridPosition, float amp);
-    void applyStepRule();
+    void applyStepRule(double time = -1.0);
+    void seedFromInput();
+    void updateVoicePower();
+    void scheduleSteps();
+    void scheduleAsync();
+    void toggleAsync();
+    void toggleSpectralNeighborhood();
+    void wakeCell(int index, double time);
+    double getCellPeriod(double freq);
+    void toggleAudioRate();
+    audio::DeviceRef findDevice(const std::string& name, audio::DeviceRef fallback);
+    void reportLatency();
     
     ivec2 getMouseGridPosition();
     void drawCell(Cell* cell);
+    void drawStats();
     
   public:
     ~CAPrototypeApp();
@@ -84,22 +127,116 @@ void CAPrototypeApp::setup()
     mRuleValues[3] = 3.1;
     
     mBase = 1.0;
-    mStepTimer = 0.0;
+    mTranspositionGlide = false;
+    mNextStepFrame = 0;
     
     mSoundEnabled = false;
     
-    audio::NodeRef master = audio::master()->getOutput();
-    audio::master()->getOutput()->enableClipDetection(false);
-    audio::master()->getOutput()->enable();
+    const std::vector<std::string>& args = getCommandLineArgs();
+    
+    // "--layout quad|ring8|foa" spreads the grid round a speaker ring or encodes it to first order ambisonics
+    SpeakerLayout::Type layout = SpeakerLayout::LAYOUT_STEREO;
+    std::vector<std::string>::const_iterator layoutArg = std::find(args.begin(), args.end(), "--layout");
+    if (layoutArg != args.end() && layoutArg + 1 != args.end())
+        SpeakerLayout::parse(*(layoutArg + 1), layout);
+    
+    // devices and buffering come from "CASynthesis.cfg" in Documents, or "--config path", then the command line
+    std::string configErrors;
+    fs::path configPath = getDocumentsDirectory() / "CASynthesis.cfg";
+    std::vector<std::string>::const_iterator configArg = std::find(args.begin(), args.end(), "--config");
+    if (configArg != args.end() && configArg + 1 != args.end())
+        configPath = *(configArg + 1);
+    if (mAudioConfig.load(configPath.string(), &configErrors))
+        console() << "audio config " << configPath << std::endl << configErrors;
+    mAudioConfig.parse(args);
+    if (mAudioConfig.listDevices)
+        console() << audio::Device::printDevicesToString() << std::endl;
+    
+    audio::Context* ctx = audio::master();
+    mOutputDevice = findDevice(mAudioConfig.outputDevice, audio::Device::getDefaultOutput());
+    audio::Device::Format deviceFormat;
+    if (mAudioConfig.sampleRate > 0)
+        deviceFormat.sampleRate(mAudioConfig.sampleRate);
+    if (mAudioConfig.framesPerBlock > 0)
+        deviceFormat.framesPerBlock(mAudioConfig.framesPerBlock);
+    if (mAudioConfig.sampleRate > 0 || mAudioConfig.framesPerBlock > 0)
+        mOutputDevice->updateFormat(deviceFormat);
+    
+    int channelsCount = SpeakerLayout(layout).getChannelsCount();
+    if (!mAudioConfig.outputDevice.empty() || channelsCount != (int)ctx->getOutput()->getNumChannels())
+        ctx->setOutput(ctx->createOutputDeviceNode(mOutputDevice, audio::Node::Format().channels(channelsCount)));
+    
+    audio::NodeRef master = ctx->getOutput();
+    ctx->getOutput()->enableClipDetection(false);
+    ctx->getOutput()->enable();
+    
+    CARule rule;
+    rule.radius = mRuleRadius;
+    mKernel.setRule(rule);
+    mKernel.resize(mGridSize);
+    mKernel.setThreadCount(std::thread::hardware_concurrency());
+    mShowStats = false;
+    
+    mAsyncEnabled = false;
+    mQueue.resize(mKernel.getCellsCount());
+    mDueCells.resize(mKernel.getCellsCount());
+    mNeighbors.resize(mKernel.getNeighborhoodSize());
+    
+    // "--engine spectral" renders through inverse FFTs instead of one oscillator per voice
+    OscillatorBankNode::Engine engine = OscillatorBankNode::ENGINE_OSCILLATORS;
+    std::vector<std::string>::const_iterator engineArg = std::find(args.begin(), args.end(), "--engine");
+    if (engineArg != args.end() && engineArg + 1 != args.end() && *(engineArg + 1) == "spectral")
+        engine = OscillatorBankNode::ENGINE_SPECTRAL;
+    
+    // "--voices n" caps the voice pool; by default every cell can sound at once
+    int voicesCount = 0;
+    std::vector<std::string>::const_iterator voicesArg = std::find(args.begin(), args.end(), "--voices");
+    if (voicesArg != args.end() && voicesArg + 1 != args.end())
+        voicesCount = std::max(0, atoi((voicesArg + 1)->c_str()));
     
     double cellsCount = mGridSize * mGridSize;
+    mBankNode = audio::master()->makeNode(new OscillatorBankNode(cellsCount, voicesCount, engine, layout));
+    // measuring keeps the bank off the output, which carries nothing but the probe's clicks
+    if (!mAudioConfig.measureLatency)
+        mBankNode >> master;
+    // a few render threads are enough for the audio deadline and leave the other cores to the kernel and the UI
+    mBankNode->setThreadCount(std::max(1, std::min((int)std::thread::hardware_concurrency() / 2, BANK_MAX_THREADS)));
+    mBankNode->setWavetable(WAVE_SAW, Wavetable(Wavetable::SHAPE_SAW));
+    mBankNode->setWavetable(WAVE_SQUARE, Wavetable(Wavetable::SHAPE_SQUARE));
+    mBankNode->enable();
+    
+    // "--input" lets the input device seed cells with its spectral peaks at every generation
+    mInputSeeding = false;
+    bool inputEnabled = std::find(args.begin(), args.end(), "--input") != args.end();
+    if (inputEnabled || mAudioConfig.measureLatency)
+        mInputNode = ctx->createInputDeviceNode(findDevice(mAudioConfig.inputDevice, audio::Device::getDefaultInput()));
+    if (inputEnabled)
+    {
+        mPeakTrackerNode = ctx->makeNode(new PeakTrackerNode());
+        mInputNode >> mPeakTrackerNode;
+        mPeakTrackerNode->enable();
+        mInputSeeding = true;
+    }
+    
+    // "--measure-latency" sends clicks out and times them coming back in; the output has to be looped to the input
+    if (mAudioConfig.measureLatency)
+    {
+        mLatencyProbeNode = ctx->makeNode(new LatencyProbeNode());
+        mInputNode >> mLatencyProbeNode >> master;
+        mLatencyProbeNode->enable();
+    }
+    if (mInputNode)
+        mInputNode->enable();
+    
+    reportLatency();
+    
     mGrid = new Cell**[mGridSize];
     for (int i = 0; i < mGridSize; ++i)
     {
         mGrid[i] = new Cell*[mGridSize];
         for (int j = 0; j < mGridSize; ++j)
         {
-            mGrid[i][j] = new Cell(ivec2(i, j), cellsCount, master);
+            mGrid[i][j] = new Cell(ivec2(i, j), cellsCount, mBankNode, mKernel.getIndex(i, j));
             
             mGrid[i][j]->setAmp(0.0);
             mGrid[i][j]->setFreq(0.0);
@@ -137,6 +274,29 @@ CAPrototypeApp::~CAPrototypeApp()
     delete mGrid;
 }
 
+audio::DeviceRef CAPrototypeApp::findDevice(const std::string& name, audio::DeviceRef fallback)
+{
+    if (name.empty())
+        return fallback;
+    
+    audio::DeviceRef device = audio::Device::findDeviceByName(name);
+    if (!device)
+        console() << "no audio device \"" << name << "\", using " << fallback->getName() << std::endl;
+    return device ? device : fallback;
+}
+
+void CAPrototypeApp::reportLatency()
+{
+    // what the app adds on its own: one block of output plus the engine's lookahead; the driver's and the
+    // converters' buffering come on top and only show in a measured round trip
+    audio::Context* ctx = audio::master();
+    double sampleRate = ctx->getSampleRate();
+    size_t frames = ctx->getFramesPerBlock() + mBankNode->getLatency();
+    console() << "audio out " << mOutputDevice->getName() << ", " << sampleRate << " Hz, "
+              << ctx->getFramesPerBlock() << " frames per block, " << frames << " frames ("
+              << 1000.0 * frames / sampleRate << " ms) before the driver" << std::endl;
+}
+
 ivec2 CAPrototypeApp::getMouseGridPosition()
 {
     vec2 cellDrawSize = getWindowSize() / mGridSize;
@@ -151,6 +311,11 @@ void CAPrototypeApp::modifyCell(ivec2 gridPosition, float amp)
 {
     Cell* cell = mGrid[gridPosition.x][gridPosition.y];
     cell->setAmp(amp);
+    mKernel.setCell(gridPosition.x, gridPosition.y, cell->getAmp(), cell->getFreq());
+    updateVoicePower();
+    
+    if (mAsyncEnabled)
+        wakeCell(mKernel.getIndex(gridPosition.x, gridPosition.y), audio::master()->getNumProcessedSeconds());
 }
 
 void CAPrototypeApp::shuffle()
@@ -163,8 +328,10 @@ void CAPrototypeApp::shuffle()
             mGrid[i][j]->setAmp(life);
             //mGrid[i][j]->setFreq(BASE_FREQ * (1 + rand() % HARMONIX_MAX));
             mGrid[i][j]->randFreq();
+            mKernel.setCell(i, j, mGrid[i][j]->getAmp(), mGrid[i][j]->getFreq());
         }
     }
+    updateVoicePower();
 }
 void CAPrototypeApp::clear()
 {
@@ -175,131 +342,216 @@ void CAPrototypeApp::clear()
             mGrid[i][j]->setAmp(0.0);
             //mGrid[i][j]->setFreq(mGrid[0][0]->getFreq());
             mGrid[i][j]->randFreq();
+            mKernel.setCell(i, j, mGrid[i][j]->getAmp(), mGrid[i][j]->getFreq());
         }
     }
+    updateVoicePower();
 }
 void CAPrototypeApp::updateBase()
 {
+    // one event for the whole grid; the bank multiplies it into every voice
+    mBankNode->setTransposition(mBase, mTranspositionGlide ? TRANSPOSE_GLIDE_TIME : 0.0);
+}
+void CAPrototypeApp::setWave(int wave)
+{
+    for (int index = 0; index < mKernel.getCellsCount(); ++index)
+        mBankNode->setWave(index, wave);
+}
+void CAPrototypeApp::updateAutomatonWave()
+{
+    // a snapshot of the grid's spectrum as overtones: the fundamental, then one harmonic per histogram bin,
+    // lowest bin first, as loud as the bin is full and rolling off like a saw
+    const CAStats& stats = mKernel.getStats();
+    float amplitudes[CAStats::HISTOGRAM_BINS + 1];
+    amplitudes[0] = 1.0f;
+    for (int k = 0; k < CAStats::HISTOGRAM_BINS; ++k)
+        amplitudes[k + 1] = (float)stats.histogram[k] / math<float>::max(1.0f, stats.population) / (k + 2);
+    
+    Wavetable table;
+    table.setHarmonics(amplitudes, CAStats::HISTOGRAM_BINS + 1);
+    mBankNode->setWavetable(WAVE_AUTOMATON, table);
+}
+void CAPrototypeApp::exportRenderStats()
+{
+    // appends so that runs at different grid sizes can be compared side by side, then starts a fresh window
+    RenderStats& stats = mBankNode->getRenderStats();
+    fs::path path = getDocumentsDirectory() / "CASynthesis render stats.csv";
+    std::ofstream out(path.string().c_str(), std::ios::app);
+    out << "grid," << mGridSize << "\n";
+    stats.getSnapshot().write(out);
+    console() << "render stats appended to " << path << std::endl;
+    stats.reset();
+}
+
+double randFreqLog(double min = 20.0, double max = 22000.0)
+{
+    return pow(2, log2(min) + ((double)rand() / RAND_MAX) * (log2(max) - log2(min)));
+}
+
+void CAPrototypeApp::seedFromInput()
+{
+    // only the newest frame counts; the older ones are drained either way so the ring never fills
+    PeakFrame frame;
+    if (!mPeakTrackerNode || !mPeakTrackerNode->getTracker().popLatest(frame) || !mInputSeeding)
+        return;
+    
+    // cells hold untransposed frequencies, so a peak seeds the cell that sounds at its pitch once transposed
+    for (int k = 0; k < frame.count; ++k)
+        mKernel.seedPartial((float)(frame.peaks[k].freq / mBase), frame.peaks[k].level);
+}
+
+void CAPrototypeApp::updateVoicePower()
+{
+    // cells sound at amp / cells, see Cell::setGainValue(), which the bank's makeup gain then levels out
+    double cellsCount = mGridSize * mGridSize;
+    mBankNode->setVoicePower(mKernel.getAmpSquaredSum() / (cellsCount * cellsCount));
+}
+
+void CAPrototypeApp::applyStepRule(double time)
+{
+    mKernel.step();
+    seedFromInput();
+    updateVoicePower();
+    
     for (int i = 0; i < mGridSize; ++i)
     {
         for (int j = 0; j < mGridSize; ++j)
         {
-            mGrid[i][j]->setBase(mBase);
+            Cell* cell = mGrid[i][j];
+            cell->setNextAmp(mKernel.getAmp(i, j));
+            cell->setNextFreq(mKernel.getFreq(i, j));
+            cell->applyNext(time);
         }
     }
 }
-double randFreqLog(double min = 20.0, double max = 22000.0)
+
+double CAPrototypeApp::getCellPeriod(double freq)
 {
-    return pow(2, log2(min) + ((double)rand() / RAND_MAX) * (log2(max) - log2(min)));
+    // cells pulse at their own frequency transposed down by whole octaves, so rhythm follows pitch
+    double rate = freq * mBase;
+    if (rate <= 0.0)
+        return STEP_TIME;
+    
+    while (rate > ASYNC_MAX_RATE)
+        rate *= 0.5;
+    while (rate <= ASYNC_MAX_RATE * 0.5)
+        rate *= 2.0;
+    
+    return 1.0 / rate;
 }
 
-void CAPrototypeApp::applyStepRule()
+void CAPrototypeApp::wakeCell(int index, double time)
 {
-    for (int i = 0; i < mGridSize; ++i)
+    const float* freqs = mKernel.getFreqs();
+    if (!mQueue.isScheduled(index))
+        mQueue.schedule(index, time + getCellPeriod(freqs[index]));
+    
+    int count = mKernel.getNeighbors(index / mGridSize, index % mGridSize, mNeighbors.data());
+    for (int n = 0; n < count; ++n)
     {
-        for (int j = 0; j < mGridSize; ++j)
+        int neighbor = mNeighbors[n];
+        if (!mQueue.isScheduled(neighbor))
+            mQueue.schedule(neighbor, time + getCellPeriod(freqs[neighbor]));
+    }
+}
+
+void CAPrototypeApp::scheduleAsync()
+{
+    // only due cells are evaluated; dead cells that did not change go dormant until a neighbour wakes them
+    audio::Context* ctx = audio::master();
+    double sampleRate = ctx->getSampleRate();
+    double now = ctx->getNumProcessedSeconds();
+    double horizon = now + (ctx->getFramesPerBlock() + sampleRate / getFrameRate()) / sampleRate;
+    
+    int count;
+    while ((count = mQueue.popDue(horizon, mDueCells.data(), (int)mDueCells.size())) > 0)
+    {
+        for (int k = 0; k < count; ++k)
         {
+            int index = mDueCells[k];
+            int i = index / mGridSize;
+            int j = index % mGridSize;
+            double time = math<double>::max(mQueue.getTime(index), now);
+            
+            bool changed = mKernel.updateCell(i, j);
+            
             Cell* cell = mGrid[i][j];
-            cell->resetNext();
-            
-            //const double lifePower = mLifePower;
-            
-            //double harmAmp = 0.0;
-            //double broAmp = 0.0;
-            
-            // remember that this "- mLifePower" makes cells die each step if it have not bros"
-            //const double noisePower = lifePower;
-            //double nextAmp = cell->getAmp();// - noisePower;
-            
-            //double maxBroFreq = cell->getFreq();
-            //double maxBroValue = 0.0;
-            
-            double state = cell->getAmp();
-            if (state == 0.0)
-            {
-                cell->randFreq(true);
-            }
-            
-            double neighborsSum = 0.0;
-            for (int ni = -mRuleRadius; ni <= mRuleRadius; ++ni)
-            {
-                for (int nj = -mRuleRadius; nj <= mRuleRadius; ++nj)
-                {
-                    if (ni == 0 && nj == 0)
-                        continue;
-                    
-                    Cell* bro = mGrid[cycledIndex(i + ni, mGridSize)][cycledIndex(j + nj, mGridSize)];
-                    neighborsSum += bro->getAmp();
-                    
-                    /*if (bro->getFreq() == 0 || cell->getFreq() == 0)
-                        continue;
-                    
-                    double currentBroAmp = bro->getAmp();// > 0 ? 1.0 : 0.0;
-                    broAmp += currentBroAmp;
-                    //midFreq += bro->getFreq() * currentBroAmp;
-                    
-                    double diff = cinder::math<double>::max(bro->getFreq(), BASE_FREQ) / cinder::math<double>::min(bro->getFreq(), BASE_FREQ);
-                    
-                    const double K = 2;
-                    const int p = 1;
-                    
-                    double dE = 2 * (dmath::pow(2 * (K * diff - dmath::floor(K * diff) - 0.5), 2 * p) - 0.5);
-                    double harm = dE * currentBroAmp;//bro->getAmp() / cell->getAmp();
-                    if (harm > maxBroValue)
-                    {
-                        maxBroValue = harm;
-                        maxBroFreq = bro->getFreq();
-                    }
-                     */
-                }
-            }
-            /*
-            if (!cell->isAlive())
-            {
-                if (broAmp >  && broAmp < mRuleValues[3])
-                {
-                    nextAmp += lifePower;
-                    cell->setNextFreq(BASE_FREQ * ((1 + rand() % HARMONIX_MAX)) );
-                    //cell->randFreq(true);
-                }
-            }
-            else
-            {
-                if (broAmp < mRuleValues[0] || broAmp > mRuleValues[1])
-                {
-                    nextAmp -= lifePower;
-                    cell->setNextFreq(BASE_FREQ * ((1 + rand() % HARMONIX_MAX)) );
-                    //cell->randFreq(true);
-                }
-            }
-            */
-            
-            double delta = -1.0;
-            const double rulesBirthCenter = 2.0;//1.9;
-            const double rulesBirthRadius = 0.37;//0.33;
-            const double rulesKeepCenter = 1.84;//1.9;
-            const double rulesKeepRadius = 0.35;//0.39;
-            const double rulesDelta = 0.07;//0.021;
-            
-            if (neighborsSum >= rulesBirthCenter - rulesBirthRadius && neighborsSum <= rulesBirthCenter + rulesBirthRadius)
-            {
-                delta = 1.0;
-            }
-            else if (neighborsSum >= rulesKeepCenter - rulesKeepRadius && neighborsSum <= rulesKeepCenter + rulesKeepRadius)
-            {
-                delta = 0.0;
-            }
-            double nextState = glm::clamp(state + delta * rulesDelta, 0.0, 1.0);
-            
-            cell->setNextAmp(nextState);
+            cell->setNextAmp(mKernel.getAmp(i, j));
+            cell->setNextFreq(mKernel.getFreq(i, j));
+            cell->applyNext(time);
+            
+            if (changed || cell->isAlive())
+                mQueue.schedule(index, time + getCellPeriod(cell->getFreq()));
+            if (changed)
+                wakeCell(index, time);
         }
     }
+    updateVoicePower();
+}
+
+void CAPrototypeApp::toggleAsync()
+{
+    mAsyncEnabled = !mAsyncEnabled;
+    if (!mAsyncEnabled)
+        return;
     
+    mQueue.clear();
+    double now = audio::master()->getNumProcessedSeconds();
     for (int i = 0; i < mGridSize; ++i)
         for (int j = 0; j < mGridSize; ++j)
-            mGrid[i][j]->applyNext();
+            if (mGrid[i][j]->isAlive())
+                wakeCell(mKernel.getIndex(i, j), now);
+}
+
+void CAPrototypeApp::toggleSpectralNeighborhood()
+{
+    CARule rule = mKernel.getRule();
+    rule.spectralNeighbors = (rule.spectralNeighbors > 0) ? 0 : SPECTRAL_NEIGHBORS;
+    mKernel.setRule(rule);
     
-    mStepTimer = 0;
+    mNeighbors.resize(mKernel.getNeighborhoodSize());
+}
+
+void CAPrototypeApp::toggleAudioRate()
+{
+    audio::Context* ctx = audio::master();
+    
+    if (mAutomatonNode == nullptr)
+    {
+        mAutomatonNode = ctx->makeNode(new AutomatonNode(CONTROL_GRID_SIZE, CONTROL_STEP_FRAMES));
+        mAutomatonNode >> ctx->getOutput();
+    }
+    
+    if (mAutomatonNode->isEnabled())
+    {
+        mAutomatonNode->disable();
+    }
+    else
+    {
+        mAutomatonNode->seed(mKernel);
+        mAutomatonNode->enable();
+    }
+}
+
+void CAPrototypeApp::scheduleSteps()
+{
+    // generations live on the audio clock: each one starts on a sample that is a multiple of the step length,
+    // and is computed ahead of time so that its ramps can be scheduled before the audio thread reaches it
+    audio::Context* ctx = audio::master();
+    double sampleRate = ctx->getSampleRate();
+    uint64_t stepFrames = std::max<uint64_t>(1, (uint64_t)(STEP_TIME * sampleRate + 0.5));
+    uint64_t processedFrames = ctx->getNumProcessedFrames();
+    uint64_t lookaheadFrames = ctx->getFramesPerBlock() + (uint64_t)(sampleRate / getFrameRate());
+    
+    // skip generations we are too late for, keeping them on the step grid
+    if (mNextStepFrame < processedFrames)
+        mNextStepFrame += ((processedFrames - mNextStepFrame) / stepFrames + 1) * stepFrames;
+    
+    while (mNextStepFrame <= processedFrames + lookaheadFrames)
+    {
+        applyStepRule(mNextStepFrame / sampleRate);
+        mNextStepFrame += stepFrames;
+    }
 }
 
 void CAPrototypeApp::keyDown( KeyEvent event )
@@ -313,6 +565,10 @@ void CAPrototypeApp::keyDown( KeyEvent event )
             applyStepRule();
             break;
             
+        case KeyEvent::KEY_b:
+            mBankNode->setMultirateEnabled(!mBankNode->isMultirateEnabled());
+            break;
+            
         case KeyEvent::KEY_c:
             clear();
             break;
@@ -343,6 +599,67 @@ void CAPrototypeApp::keyDown( KeyEvent event )
             zoom /= 10;
             break;
             
+        case KeyEvent::KEY_i:
+            mShowStats = !mShowStats;
+            break;
+            
+        case KeyEvent::KEY_l:
+            mBankNode->setGlideShape(mBankNode->getGlideShape() == OscillatorBank::GLIDE_LINEAR ? OscillatorBank::GLIDE_EXPONENTIAL : OscillatorBank::GLIDE_LINEAR);
+            break;
+            
+        case KeyEvent::KEY_m:
+            mBankNode->setRampShape(mBankNode->getRampShape() == OscillatorBank::RAMP_LINEAR ? OscillatorBank::RAMP_SMOOTH : OscillatorBank::RAMP_LINEAR);
+            break;
+            
+        case KeyEvent::KEY_n:
+            toggleSpectralNeighborhood();
+            break;
+            
+        case KeyEvent::KEY_p:
+            mBankNode->setPruningEnabled(!mBankNode->isPruningEnabled());
+            break;
+            
+        case KeyEvent::KEY_o:
+            exportRenderStats();
+            break;
+            
+        case KeyEvent::KEY_v:
+            mTranspositionGlide = !mTranspositionGlide;
+            break;
+            
+        case KeyEvent::KEY_1:
+            setWave(WAVE_SINE);
+            break;
+            
+        case KeyEvent::KEY_2:
+            setWave(WAVE_SAW);
+            break;
+            
+        case KeyEvent::KEY_3:
+            setWave(WAVE_SQUARE);
+            break;
+            
+        case KeyEvent::KEY_4:
+            updateAutomatonWave();
+            setWave(WAVE_AUTOMATON);
+            break;
+            
+        case KeyEvent::KEY_0:
+            mInputSeeding = !mInputSeeding;
+            break;
+            
+        case KeyEvent::KEY_5:
+            mBankNode->setLoudnessEnabled(!mBankNode->isLoudnessEnabled());
+            break;
+            
+        case KeyEvent::KEY_x:
+            toggleAsync();
+            break;
+            
+        case KeyEvent::KEY_z:
+            toggleAudioRate();
+            break;
+            
         case KeyEvent::KEY_q:
             mSoundEnabled = !mSoundEnabled;
             //audio::master()->getOutput()->enable(mSoundEnabled);
@@ -466,16 +783,14 @@ void CAPrototypeApp::update()
         }
     }
     
-    mStepTimer += dt;
-    if (mStepTimer >= STEP_TIME)
+    if (mSoundEnabled)
     {
-        mStepTimer = STEP_TIME;
-    
-        if (mSoundEnabled)
-        {
-            applyStepRule();
-        }
+        if (mAsyncEnabled)
+            scheduleAsync();
+        else
+            scheduleSteps();
     }
+    mBankNode->flush();
 }
 
 void CAPrototypeApp::draw()
@@ -489,6 +804,9 @@ void CAPrototypeApp::draw()
             drawCell(mGrid[i][j]);
         }
     }
+    
+    if (mShowStats)
+        drawStats();
     /*
     for (int i = 0; i < RULE_VALUES_COUNT; ++i)
     {
@@ -496,6 +814,44 @@ void CAPrototypeApp::draw()
     }*/
 }
 
+void CAPrototypeApp::drawStats()
+{
+    const CAStats& stats = mKernel.getStats();
+    
+    gl::drawString("population " + toString(stats.population) + "  mean amp " + toString(stats.getMeanAmp()), vec2(5, 5), Color::white(), mFont);
+    gl::drawString("births " + toString(stats.births) + "  deaths " + toString(stats.deaths), vec2(5, 20), Color::white(), mFont);
+    gl::drawString("voices " + toString(mBankNode->getActiveVoicesCount()) + "  pruned " + toString(mBankNode->getPrunedVoicesCount()) + (mBankNode->isPruningEnabled() ? "" : " (off)") + "  decimated " + toString(mBankNode->getDecimatedVoicesCount()) + (mBankNode->isMultirateEnabled() ? "" : " (off)"), vec2(5, 35), Color::white(), mFont);
+    
+    // loads are render time over block duration since the last reset
+    RenderStats::Snapshot render = mBankNode->getRenderStats().getSnapshot();
+    gl::drawString("load " + toString((int)(100 * render.getMeanLoad())) + "%  p99 " + toString((int)(100 * render.getLoadPercentile(0.99))) + "%  peak " + toString((int)(100 * render.peakLoad)) + "%  misses " + toString(render.deadlineMissesCount) + " of " + toString(render.blocksCount), vec2(5, 50), Color::white(), mFont);
+    std::string input = mPeakTrackerNode ? "  input " + std::string(mInputSeeding ? "on" : "off") + ", " + toString(mPeakTrackerNode->getTracker().getDroppedFramesCount()) + " frames dropped" : "";
+    gl::drawString("queue " + toString(render.queueDepth) + "  peak " + toString(render.peakQueueDepth) + "  waiting " + toString(mBankNode->getPendingEventsCount()) + "  dropped " + toString(render.droppedEventsCount) + input, vec2(5, 65), Color::white(), mFont);
+    
+    audio::Context* ctx = audio::master();
+    double sampleRate = ctx->getSampleRate();
+    std::string latency = "  out " + toString(1000.0 * (ctx->getFramesPerBlock() + mBankNode->getLatency()) / sampleRate) + " ms";
+    if (mLatencyProbeNode)
+    {
+        const LatencyProbe& probe = mLatencyProbeNode->getProbe();
+        latency += "  round trip " + (probe.getMeasurementsCount() > 0 ? toString(1000.0 * probe.getLastFrames() / sampleRate) + " ms" : std::string("-")) + ", " + toString(probe.getMissesCount()) + " missed";
+    }
+    gl::drawString(mOutputDevice->getName() + "  " + toString((int)sampleRate) + " Hz  block " + toString(ctx->getFramesPerBlock()) + latency, vec2(5, 80), Color::white(), mFont);
+    const LoudnessControl& loudness = mBankNode->getLoudness();
+    gl::drawString("makeup " + toString(20.0f * log10f(loudness.getMakeupGain())) + " dB  limiter " + toString(20.0f * log10f(loudness.getReduction())) + " dB" + (mBankNode->isLoudnessEnabled() ? "" : " (off)"), vec2(5, 95), Color::white(), mFont);
+    
+    // live cells per log frequency bin, lowest frequencies on the left
+    float barWidth = 4.0f;
+    float maxHeight = 60.0f;
+    vec2 origin(5, 115 + maxHeight);
+    gl::color(CellPresentation::getFreqColor());
+    for (int k = 0; k < CAStats::HISTOGRAM_BINS; ++k)
+    {
+        float height = maxHeight * stats.histogram[k] / math<float>::max(1.0f, stats.population);
+        gl::drawSolidRect(Rectf(origin + vec2(k * barWidth, -height), origin + vec2((k + 1) * barWidth - 1, 0)));
+    }
+}
+
 void CAPrototypeApp::drawCell(Cell* cell)
 {
     vec2 cellDrawSize = getWindowSize() / mGridSize;
@@ -0,0 +1,139 @@
+//
+//  CalendarQueue.cpp
+//  CASynthesis
+//
+//
+
+#include "CalendarQueue.h"
+
+#include <math.h>
+
+CalendarQueue::CalendarQueue(int capacity, double bucketWidth, int bucketsCount)
+{
+    int buckets = 1;
+    while (buckets < bucketsCount)
+        buckets <<= 1;
+
+    mBucketWidth = bucketWidth;
+    mBucketMask = buckets - 1;
+    mHead.assign(buckets, -1);
+    mCurrentBucket = 0;
+    mSize = 0;
+
+    resize(capacity);
+}
+
+void CalendarQueue::resize(int capacity)
+{
+    mNext.assign(capacity, -1);
+    mPrev.assign(capacity, -1);
+    mTime.assign(capacity, 0.0);
+    mSlot.assign(capacity, 0);
+    mScheduled.assign(capacity, false);
+
+    mHead.assign(mHead.size(), -1);
+    mSize = 0;
+}
+
+void CalendarQueue::clear()
+{
+    resize((int)mNext.size());
+}
+
+int CalendarQueue::size() const
+{
+    return mSize;
+}
+
+bool CalendarQueue::isScheduled(int id) const
+{
+    return mScheduled[id];
+}
+
+double CalendarQueue::getTime(int id) const
+{
+    return mTime[id];
+}
+
+int64_t CalendarQueue::getBucket(double time) const
+{
+    return (int64_t)floor(time / mBucketWidth);
+}
+
+void CalendarQueue::unlink(int id)
+{
+    int next = mNext[id];
+    int prev = mPrev[id];
+
+    if (prev >= 0)
+        mNext[prev] = next;
+    else
+        mHead[mSlot[id]] = next;
+
+    if (next >= 0)
+        mPrev[next] = prev;
+
+    mScheduled[id] = false;
+    mSize--;
+}
+
+void CalendarQueue::schedule(int id, double time)
+{
+    if (mScheduled[id])
+        unlink(id);
+
+    // events in the past land in the bucket that will be walked next
+    int64_t bucket = getBucket(time);
+    if (bucket < mCurrentBucket)
+        bucket = mCurrentBucket;
+
+    int slot = bucket & mBucketMask;
+    int& head = mHead[slot];
+    mTime[id] = time;
+    mSlot[id] = slot;
+    mPrev[id] = -1;
+    mNext[id] = head;
+    if (head >= 0)
+        mPrev[head] = id;
+    head = id;
+
+    mScheduled[id] = true;
+    mSize++;
+}
+
+void CalendarQueue::cancel(int id)
+{
+    if (mScheduled[id])
+        unlink(id);
+}
+
+int CalendarQueue::popDue(double now, int* out, int maxCount)
+{
+    int count = 0;
+    int64_t lastBucket = getBucket(now);
+
+    // a full turn of the calendar visits every bucket once, there is no need to walk further
+    int64_t firstBucket = mCurrentBucket;
+    if (lastBucket - firstBucket > mBucketMask)
+        firstBucket = lastBucket - mBucketMask;
+
+    for (int64_t bucket = firstBucket; bucket <= lastBucket && count < maxCount; ++bucket)
+    {
+        int id = mHead[bucket & mBucketMask];
+        while (id >= 0 && count < maxCount)
+        {
+            int next = mNext[id];
+            if (mTime[id] <= now)
+            {
+                unlink(id);
+                out[count++] = id;
+            }
+            id = next;
+        }
+
+        if (count < maxCount)
+            mCurrentBucket = bucket;
+    }
+
+    return count;
+}
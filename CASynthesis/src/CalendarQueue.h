@@ -0,0 +1,53 @@
+//
+//  CalendarQueue.h
+//  CASynthesis
+//
+//
+
+#ifndef CalendarQueue_h
+#define CalendarQueue_h
+
+#include <stdint.h>
+#include <vector>
+
+// Calendar queue of cell update times. Every cell has at most one pending event, kept in an intrusive
+// doubly linked list of its time bucket, so scheduling, rescheduling and cancelling are O(1) and
+// popping costs the number of due events plus the number of buckets walked.
+class CalendarQueue
+{
+protected:
+    double mBucketWidth;
+    int mBucketMask;
+
+    std::vector<int> mHead;
+    std::vector<int> mNext;
+    std::vector<int> mPrev;
+    std::vector<double> mTime;
+    std::vector<int> mSlot;
+    std::vector<bool> mScheduled;
+
+    int64_t mCurrentBucket;
+    int mSize;
+
+    int64_t getBucket(double time) const;
+    void unlink(int id);
+
+public:
+    CalendarQueue(int capacity = 0, double bucketWidth = 0.005, int bucketsCount = 256);
+
+    void resize(int capacity);
+    void clear();
+
+    int size() const;
+    bool isScheduled(int id) const;
+    double getTime(int id) const;
+
+    //! schedules \a id at \a time, replacing its pending event if any
+    void schedule(int id, double time);
+    void cancel(int id);
+
+    //! removes up to \a maxCount events due at or before \a now and writes their ids to \a out
+    int popDue(double now, int* out, int maxCount);
+};
+
+#endif /* CalendarQueue_h */
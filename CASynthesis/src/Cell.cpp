@@ -59,58 +59,32 @@ void CellPresentation::update(float dt)
     mSelectionAlpha = ci::math<float>::clamp(mSelectionAlpha);
 }
 
-void Cell::init(ivec2 position, double cellsCount, double freq, double amp, ci::audio::NodeRef masterNode)
+void Cell::init(ivec2 position, double cellsCount, double freq, double amp, OscillatorBankNodeRef bank, int index)
 {
     mPresentation = CellPresentation(this);
     
-    ci::audio::Pan2dNodeRef pan = ci::audio::master()->makeNode(new ci::audio::Pan2dNode);
-    pan->setPos((float)rand() / RAND_MAX);
-    pan->enable();
-    
-    oscSize = 2;
-    _oscArray = new ci::audio::GenSineNodeRef[oscSize];
-    _gainArray = new ci::audio::GainNodeRef[oscSize];
-    for (int i = 0; i < oscSize; ++i)
-    {
-        osc = _oscArray[i] = ci::audio::master()->makeNode(new ci::audio::GenSineNode);
-        gain = _gainArray[i] = ci::audio::master()->makeNode(new ci::audio::GainNode);
-        
-        osc->enable();
-        osc >> gain >> pan >> masterNode;
-    }
-    
-    oscCounter = 0;
-    updateActiveOsc();
+    mBank = bank;
+    mIndex = index;
     
     mCellsCount = cellsCount;
     
     mGridPosition = position;
-    setFreq(freq, false);
-    setBase(1.0);
-    setAmp(amp, false);
+    mFreq = freq;
+    mAmp = ci::math<double>::clamp(amp);
+    updateFreq(false);
+    setGainValue(mAmp, false);
     
     mState = rand() % 16;
     
     resetNext();
 }
-Cell::Cell(ivec2 position, double cellsCount, ci::audio::NodeRef masterNode)
+Cell::Cell(ivec2 position, double cellsCount, OscillatorBankNodeRef bank, int index)
 {
-    init(position, cellsCount, 0, 0, masterNode);
+    init(position, cellsCount, 0, 0, bank, index);
 }
-Cell::Cell(ivec2 position, double cellsCount, double freq, ci::audio::NodeRef masterNode)
+Cell::Cell(ivec2 position, double cellsCount, double freq, OscillatorBankNodeRef bank, int index)
 {
-    init(position, cellsCount, freq, 1.0, masterNode);
-}
-Cell::~Cell()
-{
-    delete [] _oscArray;
-    delete [] _gainArray;
-}
-
-void Cell::updateActiveOsc()
-{
-    osc = _oscArray[oscCounter % oscSize];
-    gain = _gainArray[oscCounter % oscSize];
+    init(position, cellsCount, freq, 1.0, bank, index);
 }
 
 CellPresentation& Cell::getPresentation()
@@ -127,24 +101,18 @@ double Cell::getAmp()
 {
     return mAmp;
 }
-void Cell::setAmp(double amp, bool fade)
+void Cell::setAmp(double amp, bool fade, double time)
 {
-    mAmp = ci::math<double>::clamp(amp);
+    amp = ci::math<double>::clamp(amp);
+    if (amp == mAmp)
+        return;
+    mAmp = amp;
     
-    setGainValue(mAmp, fade);
+    setGainValue(mAmp, fade, time);
 }
-void Cell::setGainValue(double gainValue, bool fade, bool reset)
+void Cell::setGainValue(double gainValue, bool fade, double time)
 {
-    if (gain != nullptr)
-    {
-        if (reset)
-            gain->getParam()->setValue(0.0);
-        
-        if (fade)
-            gain->getParam()->applyRamp(gainValue / mCellsCount, ATTACK_TIME);
-        else
-            gain->setValue(gainValue / mCellsCount);
-    }
+    mBank->rampGain(mIndex, gainValue / mCellsCount, fade ? ATTACK_TIME : 0.0, time);
 }
 void Cell::setNextAmp(double amp)
 {
@@ -160,10 +128,10 @@ void Cell::randFreq(bool next, float lowest, float highest)
         setFreq(freq);
 }
 
-void Cell::applyNext()
+void Cell::applyNext(double time)
 {
-    setFreq(mNextFreq);
-    setAmp(mNextAmp);
+    setFreq(mNextFreq, true, time);
+    setAmp(mNextAmp, true, time);
 }
 
 void Cell::resetNext()
@@ -176,37 +144,18 @@ double Cell::getFreq()
 {
     return mFreq;
 }
-void Cell::setFreq(double freq, bool crossfade)
+void Cell::setFreq(double freq, bool glide, double time)
 {
-    crossfade = crossfade && (mFreq != freq);
-    mFreq = freq;
-    
-    updateFreq(crossfade);
-}
-
-void Cell::setBase(double base)
-{
-    if (base == mBase)
+    if (freq == mFreq)
         return;
+    mFreq = freq;
     
-    mBase = base;
-    
-    updateFreq(false);
+    updateFreq(glide, time);
 }
 
-void Cell::updateFreq(bool swapOsc)
+void Cell::updateFreq(bool glide, double time)
 {
-    if (osc != nullptr)
-    {
-        if (swapOsc)
-        {
-            setGainValue(0.0);
-            oscCounter++;
-            updateActiveOsc();
-            setGainValue(1.0, true, true);
-        }
-        osc->getParamFreq()->setValue(mBase * mFreq);
-    }
+    mBank->setFreq(mIndex, mFreq, glide ? ATTACK_TIME : 0.0, time);
 }
 
 void Cell::setNextFreq(double freq)
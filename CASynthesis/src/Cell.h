@@ -12,6 +12,8 @@
 #include "cinder/cinder.h"
 #include "cinder/audio/audio.h"
 
+#include "OscillatorBankNode.h"
+
 using namespace cinder;
 
 class Cell;
@@ -62,7 +64,6 @@ class Cell
 protected:
     ivec2 mGridPosition;
     double mFreq;
-    double mBase;
     double mNextFreq;
     double mNextAmp;
     double mAmp;
@@ -71,24 +72,16 @@ protected:
     
     CellPresentation mPresentation;
     
-    audio::GenSineNodeRef osc;
-    audio::GainNodeRef gain;
-    
-    audio::GenSineNodeRef* _oscArray;
-    audio::GainNodeRef* _gainArray;
-    
-    unsigned int oscCounter;
-    unsigned int oscSize;
+    OscillatorBankNodeRef mBank;
+    int mIndex;
     
-    void updateActiveOsc();
-    void updateFreq(bool swapOsc = false);
-    void setGainValue(double gainValue, bool fade = true, bool reset = false);
+    void updateFreq(bool glide = false, double time = -1.0);
+    void setGainValue(double gainValue, bool fade = true, double time = -1.0);
     
-    void init(ivec2 position, double cellsCount, double freq, double amp, ci::audio::NodeRef masterNode);
+    void init(ivec2 position, double cellsCount, double freq, double amp, OscillatorBankNodeRef bank, int index);
 public:
-    Cell(ivec2 position, double cellsCount, ci::audio::NodeRef masterNode);
-    Cell(ivec2 position, double cellsCount, double freq, ci::audio::NodeRef masterNode);
-    ~Cell();
+    Cell(ivec2 position, double cellsCount, OscillatorBankNodeRef bank, int index);
+    Cell(ivec2 position, double cellsCount, double freq, OscillatorBankNodeRef bank, int index);
     
     CellPresentation& getPresentation();
     
@@ -103,11 +96,11 @@ public:
     void setNextFreq(double freq);
     
     
-    void setAmp(double amp, bool fade = true);
-    void setFreq(double freq, bool crossfade = true);
-    void setBase(double freq);
+    // time is an absolute audio context time in seconds, negative means "now"; an unchanged value sends nothing
+    void setAmp(double amp, bool fade = true, double time = -1.0);
+    void setFreq(double freq, bool glide = true, double time = -1.0);
     
-    void applyNext();
+    void applyNext(double time = -1.0);
     void resetNext();
     
     ivec2 getGridPosition();
@@ -0,0 +1,84 @@
+//
+//  FFT.cpp
+//  CASynthesis
+//
+//
+
+#include "FFT.h"
+
+#include <math.h>
+#include <algorithm>
+
+FFT::FFT(int size)
+{
+    resize(size);
+}
+
+void FFT::resize(int size)
+{
+    mSize = size;
+
+    mTwiddles.resize(size / 2);
+    for (int k = 0; k < size / 2; ++k)
+    {
+        double angle = -2.0 * M_PI * k / size;
+        mTwiddles[k] = std::complex<float>((float)cos(angle), (float)sin(angle));
+    }
+
+    int bits = 0;
+    while ((1 << bits) < size)
+        ++bits;
+
+    mReversed.resize(size);
+    for (int k = 0; k < size; ++k)
+    {
+        int reversed = 0;
+        for (int b = 0; b < bits; ++b)
+            reversed |= ((k >> b) & 1) << (bits - 1 - b);
+        mReversed[k] = reversed;
+    }
+}
+
+int FFT::getSize() const
+{
+    return mSize;
+}
+
+void FFT::forward(std::complex<float>* data) const
+{
+    transform(data, false);
+}
+
+void FFT::inverse(std::complex<float>* data) const
+{
+    transform(data, true);
+}
+
+void FFT::transform(std::complex<float>* data, bool inverse) const
+{
+    for (int k = 0; k < mSize; ++k)
+    {
+        if (k < mReversed[k])
+            std::swap(data[k], data[mReversed[k]]);
+    }
+
+    for (int length = 2; length <= mSize; length <<= 1)
+    {
+        const int half = length / 2;
+        const int stride = mSize / length;
+        for (int start = 0; start < mSize; start += length)
+        {
+            for (int k = 0; k < half; ++k)
+            {
+                // written out rather than operator* so that builds without fast math skip the NaN handling
+                const std::complex<float>& twiddle = mTwiddles[k * stride];
+                const float twiddleImag = inverse ? -twiddle.imag() : twiddle.imag();
+                const std::complex<float>& value = data[start + k + half];
+                std::complex<float> odd(value.real() * twiddle.real() - value.imag() * twiddleImag,
+                                        value.real() * twiddleImag + value.imag() * twiddle.real());
+                data[start + k + half] = data[start + k] - odd;
+                data[start + k] += odd;
+            }
+        }
+    }
+}
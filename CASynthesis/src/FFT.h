@@ -0,0 +1,35 @@
+//
+//  FFT.h
+//  CASynthesis
+//
+//
+
+#ifndef FFT_h
+#define FFT_h
+
+#include <complex>
+#include <vector>
+
+// In place iterative radix-2 FFT with precomputed twiddles and bit reversal. Neither direction
+// is normalised: inverse(forward(x)) == size * x.
+class FFT
+{
+protected:
+    int mSize;
+    std::vector<std::complex<float> > mTwiddles;
+    std::vector<int> mReversed;
+
+    void transform(std::complex<float>* data, bool inverse) const;
+
+public:
+    FFT(int size = 0);
+
+    //! \a size has to be a power of two
+    void resize(int size);
+    int getSize() const;
+
+    void forward(std::complex<float>* data) const;
+    void inverse(std::complex<float>* data) const;
+};
+
+#endif /* FFT_h */
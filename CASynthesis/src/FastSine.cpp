@@ -0,0 +1,139 @@
+//
+//  FastSine.cpp
+//  CASynthesis
+//
+//
+
+#include "FastSine.h"
+
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+namespace fastsine
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    template <int Terms>
+    static double runPolynomial(const std::vector<float>& increments, std::vector<float>& phases, std::vector<float>& out, int blocksCount, double& error)
+    {
+        const int voicesCount = (int)increments.size();
+        const int framesCount = (int)out.size();
+
+        Clock::time_point start = Clock::now();
+        for (int block = 0; block < blocksCount; ++block)
+        {
+            for (int v = 0; v < voicesCount; ++v)
+            {
+                float phase = phases[v];
+                for (int k = 0; k < framesCount; ++k)
+                {
+                    out[k] += sin2pi<Terms>(phase);
+                    phase += increments[v];
+                    phase = (phase >= 1.0f) ? phase - 1.0f : phase;
+                }
+                phases[v] = phase;
+            }
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        error = 0.0;
+        for (int k = 0; k < 1 << 16; ++k)
+        {
+            float phase = k / 65536.0f;
+            error = std::max(error, fabs(sin2pi<Terms>(phase) - sin(2.0 * M_PI * phase)));
+        }
+        return seconds;
+    }
+
+    void benchmark(std::ostream& out, int voicesCount, int framesCount, int blocksCount)
+    {
+        std::vector<float> increments(voicesCount);
+        std::vector<float> phases(voicesCount, 0.0f);
+        std::vector<float> buffer(framesCount, 0.0f);
+        for (int v = 0; v < voicesCount; ++v)
+            increments[v] = (float)(20.0 * pow(1000.0, (double)v / voicesCount) / 48000.0);
+
+        const double samples = (double)voicesCount * framesCount * blocksCount;
+        double seconds;
+        double error;
+
+        Clock::time_point start = Clock::now();
+        for (int block = 0; block < blocksCount; ++block)
+        {
+            for (int v = 0; v < voicesCount; ++v)
+            {
+                float phase = phases[v];
+                for (int k = 0; k < framesCount; ++k)
+                {
+                    buffer[k] += std::sin(phase * (float)(2.0 * M_PI));
+                    phase += increments[v];
+                    phase = (phase >= 1.0f) ? phase - 1.0f : phase;
+                }
+                phases[v] = phase;
+            }
+        }
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        out << "std::sin            " << seconds * 1e9 / samples << " ns per voice sample" << std::endl;
+
+        seconds = runPolynomial<ACCURACY_LOW>(increments, phases, buffer, blocksCount, error);
+        out << "polynomial, 3 terms " << seconds * 1e9 / samples << " ns per voice sample, error " << error << std::endl;
+        seconds = runPolynomial<ACCURACY_MEDIUM>(increments, phases, buffer, blocksCount, error);
+        out << "polynomial, 4 terms " << seconds * 1e9 / samples << " ns per voice sample, error " << error << std::endl;
+        seconds = runPolynomial<ACCURACY_HIGH>(increments, phases, buffer, blocksCount, error);
+        out << "polynomial, 5 terms " << seconds * 1e9 / samples << " ns per voice sample, error " << error << std::endl;
+
+        // the bank's steady voices: voices in lanes, one complex rotation per sample, reseeded every block
+        const int lanes = 8;
+        std::vector<float> cosines(voicesCount);
+        std::vector<float> sines(voicesCount);
+        for (int v = 0; v < voicesCount; ++v)
+        {
+            cosines[v] = (float)cos(2.0 * M_PI * increments[v]);
+            sines[v] = (float)sin(2.0 * M_PI * increments[v]);
+        }
+
+        start = Clock::now();
+        for (int block = 0; block < blocksCount; ++block)
+        {
+            for (int v = 0; v + lanes <= voicesCount; v += lanes)
+            {
+                float re[lanes];
+                float im[lanes];
+                for (int l = 0; l < lanes; ++l)
+                {
+                    re[l] = cos2pi<ACCURACY_HIGH>(phases[v + l]);
+                    im[l] = sin2pi<ACCURACY_HIGH>(phases[v + l]);
+                }
+
+                for (int k = 0; k < framesCount; ++k)
+                {
+                    float sum = 0.0f;
+                    for (int l = 0; l < lanes; ++l)
+                    {
+                        sum += im[l];
+                        float rotated = re[l] * cosines[v + l] - im[l] * sines[v + l];
+                        im[l] = re[l] * sines[v + l] + im[l] * cosines[v + l];
+                        re[l] = rotated;
+                    }
+                    buffer[k] += sum;
+                }
+
+                for (int l = 0; l < lanes; ++l)
+                {
+                    double phase = phases[v + l] + (double)increments[v + l] * framesCount;
+                    phases[v + l] = (float)(phase - floor(phase));
+                }
+            }
+        }
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        out << "phasor recurrence   " << seconds * 1e9 / samples << " ns per voice sample" << std::endl;
+
+        // keeps the optimiser from dropping the loops above
+        float checksum = 0.0f;
+        for (int k = 0; k < framesCount; ++k)
+            checksum += buffer[k];
+        out << "(checksum " << checksum << ")" << std::endl;
+    }
+}
@@ -0,0 +1,55 @@
+//
+//  FastSine.h
+//  CASynthesis
+//
+//
+
+#ifndef FastSine_h
+#define FastSine_h
+
+#include <ostream>
+
+namespace fastsine
+{
+    //! number of odd polynomial terms, worst absolute error in float: 7e-5, 7e-7 and 3e-7
+    enum Accuracy
+    {
+        ACCURACY_LOW = 3,
+        ACCURACY_MEDIUM = 4,
+        ACCURACY_HIGH = 5
+    };
+
+    //! sin(2 * pi * phase) for phase in [0, 1), branch free so that loops over it vectorise
+    template <int Terms>
+    inline float sin2pi(float phase)
+    {
+        // sin(2 pi p) = -sin(2 pi x) with x = p - 1/2, and x is folded into [-1/4, 1/4] where the polynomial is fitted
+        float x = phase - 0.5f;
+        x = (x > 0.25f) ? 0.5f - x : x;
+        x = (x < -0.25f) ? -0.5f - x : x;
+
+        // minimax coefficients for sin(2 pi x) on [-1/4, 1/4]
+        const float x2 = x * x;
+        float poly;
+        if (Terms <= 3)
+            poly = 6.281280095e+00f + x2 * (-4.109524465e+01f + x2 * 7.358553911e+01f);
+        else if (Terms == 4)
+            poly = 6.283163380e+00f + x2 * (-4.133707654e+01f + x2 * (8.133890460e+01f + x2 * -7.097756854e+01f));
+        else
+            poly = 6.283185893e+00f + x2 * (-4.134200420e+01f + x2 * (8.162667918e+01f + x2 * (-7.715949911e+01f + x2 * 4.411961137e+01f)));
+
+        return -x * poly;
+    }
+
+    template <int Terms>
+    inline float cos2pi(float phase)
+    {
+        phase += 0.25f;
+        return sin2pi<Terms>((phase >= 1.0f) ? phase - 1.0f : phase);
+    }
+
+    //! times std::sin against the polynomials and the phasor recurrence used by the oscillator bank
+    void benchmark(std::ostream& out, int voicesCount = 1024, int framesCount = 512, int blocksCount = 64);
+}
+
+#endif /* FastSine_h */
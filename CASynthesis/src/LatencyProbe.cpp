@@ -0,0 +1,106 @@
+//
+//  LatencyProbe.cpp
+//  CASynthesis
+//
+//
+
+#include "LatencyProbe.h"
+
+#include <math.h>
+#include <algorithm>
+
+const int LatencyProbe::CLICKS_PER_SECOND;
+
+static const int64_t NO_CLICK = -1;
+
+LatencyProbe::LatencyProbe(double sampleRate, float threshold, float clickAmp)
+: mMeasurementsCount(0), mMissesCount(0), mLastFrames(-1), mMinFrames(-1), mMaxFrames(-1), mSumFrames(0)
+{
+    mSampleRate = sampleRate;
+    mThreshold = threshold;
+    mClickAmp = clickAmp;
+    mFrame = 0;
+    mClickFrame = NO_CLICK;
+}
+
+void LatencyProbe::setSampleRate(double sampleRate)
+{
+    mSampleRate = sampleRate;
+}
+
+double LatencyProbe::getSampleRate() const
+{
+    return mSampleRate;
+}
+
+size_t LatencyProbe::getPeriodFrames() const
+{
+    return std::max<size_t>(1, (size_t)(mSampleRate / CLICKS_PER_SECOND));
+}
+
+void LatencyProbe::process(const float* input, float* const* outputs, int channelsCount, size_t frames)
+{
+    const std::memory_order relaxed = std::memory_order_relaxed;
+    const int64_t period = (int64_t)getPeriodFrames();
+
+    for (size_t k = 0; k < frames; ++k, ++mFrame)
+    {
+        // read before the outputs are written, they may be the same buffer
+        const float sample = input[k];
+
+        if (mClickFrame != NO_CLICK && fabsf(sample) > mThreshold)
+        {
+            const int64_t latency = mFrame - mClickFrame;
+            const int64_t minFrames = mMinFrames.load(relaxed);
+            mLastFrames.store(latency, relaxed);
+            mMinFrames.store((minFrames < 0) ? latency : std::min(minFrames, latency), relaxed);
+            mMaxFrames.store(std::max(mMaxFrames.load(relaxed), latency), relaxed);
+            mSumFrames.store(mSumFrames.load(relaxed) + latency, relaxed);
+            mMeasurementsCount.store(mMeasurementsCount.load(relaxed) + 1, relaxed);
+            mClickFrame = NO_CLICK;
+        }
+
+        float click = 0.0f;
+        if (mFrame % period == 0)
+        {
+            if (mClickFrame != NO_CLICK)
+                mMissesCount.store(mMissesCount.load(relaxed) + 1, relaxed);
+            mClickFrame = mFrame;
+            click = mClickAmp;
+        }
+
+        for (int channel = 0; channel < channelsCount; ++channel)
+            outputs[channel][k] = click;
+    }
+}
+
+uint32_t LatencyProbe::getMeasurementsCount() const
+{
+    return mMeasurementsCount.load(std::memory_order_relaxed);
+}
+
+uint32_t LatencyProbe::getMissesCount() const
+{
+    return mMissesCount.load(std::memory_order_relaxed);
+}
+
+int64_t LatencyProbe::getLastFrames() const
+{
+    return mLastFrames.load(std::memory_order_relaxed);
+}
+
+int64_t LatencyProbe::getMinFrames() const
+{
+    return mMinFrames.load(std::memory_order_relaxed);
+}
+
+int64_t LatencyProbe::getMaxFrames() const
+{
+    return mMaxFrames.load(std::memory_order_relaxed);
+}
+
+double LatencyProbe::getMeanFrames() const
+{
+    const uint32_t count = getMeasurementsCount();
+    return (count > 0) ? (double)mSumFrames.load(std::memory_order_relaxed) / count : -1.0;
+}
@@ -0,0 +1,58 @@
+//
+//  LatencyProbe.h
+//  CASynthesis
+//
+//
+
+#ifndef LatencyProbe_h
+#define LatencyProbe_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// Round trip latency by loopback: a one sample click goes out every period and the input is watched for the first
+// sample above the threshold after it. Input and output samples handed to one process() call share their frame
+// numbers, so the distance between click and detection is everything in between: output buffering, converters,
+// the cable or loopback route, and input buffering. A click not heard back before the next one counts as a miss.
+// Results are relaxed atomics with the audio thread as their only writer.
+class LatencyProbe
+{
+protected:
+    double mSampleRate;
+    float mThreshold;
+    float mClickAmp;
+    int64_t mFrame;
+    int64_t mClickFrame;
+
+    std::atomic<uint32_t> mMeasurementsCount;
+    std::atomic<uint32_t> mMissesCount;
+    std::atomic<int64_t> mLastFrames;
+    std::atomic<int64_t> mMinFrames;
+    std::atomic<int64_t> mMaxFrames;
+    std::atomic<int64_t> mSumFrames;
+
+    size_t getPeriodFrames() const;
+
+public:
+    //! clicks per second; a round trip has to be shorter than the period
+    static const int CLICKS_PER_SECOND = 2;
+
+    LatencyProbe(double sampleRate = 44100.0, float threshold = 0.1f, float clickAmp = 0.5f);
+
+    void setSampleRate(double sampleRate);
+    double getSampleRate() const;
+
+    //! audio thread: every channel of \a outputs is overwritten with the clicks; \a input may be outputs[0]
+    void process(const float* input, float* const* outputs, int channelsCount, size_t frames);
+
+    uint32_t getMeasurementsCount() const;
+    uint32_t getMissesCount() const;
+    //! round trips in frames, -1 before the first measurement
+    int64_t getLastFrames() const;
+    int64_t getMinFrames() const;
+    int64_t getMaxFrames() const;
+    double getMeanFrames() const;
+};
+
+#endif /* LatencyProbe_h */
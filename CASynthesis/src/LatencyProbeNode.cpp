@@ -0,0 +1,39 @@
+//
+//  LatencyProbeNode.cpp
+//  CASynthesis
+//
+//
+
+#include "LatencyProbeNode.h"
+#include "RealtimeGuard.h"
+
+using namespace ci;
+
+LatencyProbeNode::LatencyProbeNode(const Format& format)
+: Node(format)
+{
+    setChannelMode(ChannelMode::MATCHES_OUTPUT);
+}
+
+void LatencyProbeNode::initialize()
+{
+    mProbe.setSampleRate(getSampleRate());
+    mChannels.resize(getNumChannels());
+}
+
+void LatencyProbeNode::process(audio::Buffer* buffer)
+{
+    RealtimeGuard::Scope realtime;
+
+    // a mono input arrives copied to every channel, so the first one is the input either way
+    const int channelsCount = (int)std::min(mChannels.size(), buffer->getNumChannels());
+    for (int channel = 0; channel < channelsCount; ++channel)
+        mChannels[channel] = buffer->getChannel(channel);
+
+    mProbe.process(buffer->getChannel(0), mChannels.data(), channelsCount, buffer->getNumFrames());
+}
+
+const LatencyProbe& LatencyProbeNode::getProbe() const
+{
+    return mProbe;
+}
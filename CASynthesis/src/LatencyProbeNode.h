@@ -0,0 +1,36 @@
+//
+//  LatencyProbeNode.h
+//  CASynthesis
+//
+//
+
+#ifndef LatencyProbeNode_h
+#define LatencyProbeNode_h
+
+#include "cinder/audio/Node.h"
+
+#include <vector>
+
+#include "LatencyProbe.h"
+
+typedef std::shared_ptr<class LatencyProbeNode> LatencyProbeNodeRef;
+
+// Sits between the input device and the output: listens to its input's first channel and replaces every channel
+// with the probe's clicks, so nothing of the input reaches the speakers. The output has to be looped back to the
+// input, by a cable or by the driver, for the probe to hear anything.
+class LatencyProbeNode : public ci::audio::Node
+{
+protected:
+    LatencyProbe mProbe;
+    std::vector<float*> mChannels;
+
+    void initialize() override;
+    void process(ci::audio::Buffer* buffer) override;
+
+public:
+    LatencyProbeNode(const Format& format = Format());
+
+    const LatencyProbe& getProbe() const;
+};
+
+#endif /* LatencyProbeNode_h */
@@ -0,0 +1,91 @@
+//
+//  LoudnessControl.cpp
+//  CASynthesis
+//
+//
+
+#include "LoudnessControl.h"
+
+#include <math.h>
+#include <algorithm>
+
+const float LoudnessControl::MIN_GAIN = 0.25f;
+const float LoudnessControl::MAX_GAIN = 64.0f;
+const float LoudnessControl::RISE_SECONDS = 0.5f;
+const float LoudnessControl::FALL_SECONDS = 0.05f;
+const float LoudnessControl::RELEASE_SECONDS = 0.1f;
+
+LoudnessControl::LoudnessControl(double sampleRate, float targetLevel, float ceiling)
+: mTargetGain(1.0f), mMakeupGain(1.0f), mReduction(1.0f)
+{
+    mTargetLevel = powf(10.0f, targetLevel / 20.0f);
+    mCeiling = powf(10.0f, ceiling / 20.0f);
+    mGain = 1.0f;
+    mEnvelope = 0.0f;
+    setSampleRate(sampleRate);
+}
+
+void LoudnessControl::setSampleRate(double sampleRate)
+{
+    mSampleRate = sampleRate;
+    mReleaseCoef = expf(-1.0f / (RELEASE_SECONDS * (float)sampleRate));
+}
+
+double LoudnessControl::getSampleRate() const
+{
+    return mSampleRate;
+}
+
+void LoudnessControl::setVoicePower(double gainSquaredSum)
+{
+    if (gainSquaredSum <= 0.0)
+        return;
+
+    const float level = (float)sqrt(0.5 * gainSquaredSum);
+    mTargetGain = std::min(std::max(mTargetLevel / level, MIN_GAIN), MAX_GAIN);
+}
+
+void LoudnessControl::process(float* const* channels, int channelsCount, size_t frames)
+{
+    if (frames == 0)
+        return;
+
+    // one step of a one pole smoother per block, followed by a straight line across it
+    const float target = mTargetGain.load(std::memory_order_relaxed);
+    const float seconds = (target < mGain) ? FALL_SECONDS : RISE_SECONDS;
+    const float nextGain = mGain + (target - mGain) * (1.0f - expf(-(float)frames / (seconds * (float)mSampleRate)));
+    const float gainStep = (nextGain - mGain) / frames;
+
+    float gain = mGain;
+    float envelope = mEnvelope;
+    float reduction = 1.0f;
+    for (size_t k = 0; k < frames; ++k)
+    {
+        float peak = 0.0f;
+        for (int channel = 0; channel < channelsCount; ++channel)
+            peak = std::max(peak, fabsf(channels[channel][k]));
+
+        envelope = std::max(peak * gain, envelope * mReleaseCoef);
+        const float limit = (envelope > mCeiling) ? mCeiling / envelope : 1.0f;
+        reduction = std::min(reduction, limit);
+
+        for (int channel = 0; channel < channelsCount; ++channel)
+            channels[channel][k] *= gain * limit;
+        gain += gainStep;
+    }
+
+    mGain = nextGain;
+    mEnvelope = envelope;
+    mMakeupGain.store(nextGain, std::memory_order_relaxed);
+    mReduction.store(reduction, std::memory_order_relaxed);
+}
+
+float LoudnessControl::getMakeupGain() const
+{
+    return mMakeupGain.load(std::memory_order_relaxed);
+}
+
+float LoudnessControl::getReduction() const
+{
+    return mReduction.load(std::memory_order_relaxed);
+}
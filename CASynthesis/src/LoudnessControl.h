@@ -0,0 +1,56 @@
+//
+//  LoudnessControl.h
+//  CASynthesis
+//
+//
+
+#ifndef LoudnessControl_h
+#define LoudnessControl_h
+
+#include <stddef.h>
+#include <atomic>
+
+// Makeup gain that holds the bank's mix near a target RMS estimated from the voices' gains, then a peak limiter.
+class LoudnessControl
+{
+protected:
+    double mSampleRate;
+    float mTargetLevel;
+    float mCeiling;
+    std::atomic<float> mTargetGain;
+
+    float mGain;
+    float mEnvelope;
+    float mReleaseCoef;
+
+    std::atomic<float> mMakeupGain;
+    std::atomic<float> mReduction;
+
+public:
+    //! makeup is kept within these bounds, so an almost silent grid is not lifted into the noise
+    static const float MIN_GAIN;
+    static const float MAX_GAIN;
+    //! time constants of the makeup gain going up and down, and of the limiter's release
+    static const float RISE_SECONDS;
+    static const float FALL_SECONDS;
+    static const float RELEASE_SECONDS;
+
+    //! \a targetLevel is RMS in dBFS, \a ceiling the limiter's in dBFS
+    LoudnessControl(double sampleRate = 44100.0, float targetLevel = -20.0f, float ceiling = -1.0f);
+
+    void setSampleRate(double sampleRate);
+    double getSampleRate() const;
+
+    //! control thread: \a gainSquaredSum is the sum of the squared gains of every sounding voice; silence keeps
+    //! the last makeup so the next sound starts where the last one left off
+    void setVoicePower(double gainSquaredSum);
+
+    //! audio thread: scales and limits \a frames frames of each of \a channelsCount channels in place
+    void process(float* const* channels, int channelsCount, size_t frames);
+
+    //! as of the last block: the makeup gain and the limiter's deepest gain reduction, both linear
+    float getMakeupGain() const;
+    float getReduction() const;
+};
+
+#endif /* LoudnessControl_h */
@@ -0,0 +1,324 @@
+//
+//  OfflineRender.cpp
+//  CASynthesis
+//
+//
+
+// Command line renderer: steps the automaton on the sample clock and writes the bank's output to a WAV file
+// as fast as the CPU allows, with no audio device or Cinder context involved. Generations and ramps follow
+// the app: every STEP_TIME the grid steps, and each cell ramps to amp / cellsCount and glides to its new
+// frequency over ATTACK_TIME. Cells pan to their place on the grid, one file channel per layout channel.
+//
+// With --bands the bank gets one voice per log frequency band instead of one per cell, driven by the band sums
+// the kernel collects while stepping, so grids far beyond what per cell voices allow still follow their spectrum.
+// Bands have no place on the grid, so they pan by frequency, lowest on the left. The mode is offline only: the
+// app always gives every cell its own voice.
+// With --normalise the output goes through the app's LoudnessControl, fed from the kernel's statistics.
+//
+//  OfflineRender --seconds 60 --size 32 --out render.wav
+//  OfflineRender --seconds 60 --size 1024 --bands 2048 --out million.wav
+
+#include "CAKernel.h"
+#include "OscillatorBank.h"
+#include "SpectralSynth.h"
+#include "WavWriter.h"
+#include "LoudnessControl.h"
+#include "FastSine.h"
+#include "Defines.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const char* getArg(const std::vector<std::string>& args, const char* name, const char* fallback)
+{
+    std::vector<std::string>::const_iterator arg = std::find(args.begin(), args.end(), name);
+    if (arg != args.end() && arg + 1 != args.end())
+        return (arg + 1)->c_str();
+    return fallback;
+}
+
+static bool hasArg(const std::vector<std::string>& args, const char* name)
+{
+    return std::find(args.begin(), args.end(), name) != args.end();
+}
+
+static void printUsage()
+{
+    printf("usage: OfflineRender [options]\n"
+           "  --out path         WAV file to write (render.wav)\n"
+           "  --seconds s        length of the render (10)\n"
+           "  --rate hz          sample rate (48000)\n"
+           "  --block frames     frames per render call (512)\n"
+           "  --bits 16|24|32    sample format, 32 is float (24)\n"
+           "  --size n           grid side (12)\n"
+           "  --voices n         voice pool size, 0 for one per cell (0)\n"
+           "  --bands n          one voice per log frequency band rather than per cell, 0 for off (0)\n"
+           "  --engine spectral  inverse FFT synthesis instead of oscillators\n"
+           "  --wave name        sine, saw or square, band limited wavetables for every voice (sine)\n"
+           "  --layout name      stereo, quad, ring8 or foa (stereo)\n"
+           "  --threads n        kernel and bank threads (all cores)\n"
+           "  --seed n           random seed for the initial grid (1)\n"
+           "  --no-multirate     render every voice at the full rate\n"
+           "  --normalise        makeup gain and limiter as in the app, rather than a fixed amp / cells\n"
+           "  --bench-sine       time the sine approximations against std::sin and exit\n");
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> args(argv + 1, argv + argc);
+    if (hasArg(args, "--help") || hasArg(args, "-h"))
+    {
+        printUsage();
+        return 0;
+    }
+    if (hasArg(args, "--bench-sine"))
+    {
+        fastsine::benchmark(std::cout);
+        return 0;
+    }
+
+    const std::string path = getArg(args, "--out", "render.wav");
+    const double seconds = std::max(0.0, atof(getArg(args, "--seconds", "10")));
+    const int sampleRate = std::max(1, atoi(getArg(args, "--rate", "48000")));
+    const size_t blockFrames = std::max(1, atoi(getArg(args, "--block", "512")));
+    const int bits = atoi(getArg(args, "--bits", "24"));
+    if (bits != 16 && bits != 24 && bits != 32)
+    {
+        fprintf(stderr, "unsupported bits %s\n", getArg(args, "--bits", ""));
+        return 1;
+    }
+    const int gridSize = std::max(1, atoi(getArg(args, "--size", "12")));
+    const int voicesCount = std::max(0, atoi(getArg(args, "--voices", "0")));
+    const int bandsCount = std::max(0, atoi(getArg(args, "--bands", "0")));
+    const bool spectral = std::string(getArg(args, "--engine", "")) == "spectral";
+    SpeakerLayout::Type layout = SpeakerLayout::LAYOUT_STEREO;
+    if (!SpeakerLayout::parse(getArg(args, "--layout", "stereo"), layout))
+    {
+        fprintf(stderr, "unknown layout %s\n", getArg(args, "--layout", ""));
+        return 1;
+    }
+    const int channelsCount = SpeakerLayout(layout).getChannelsCount();
+    const std::string wave = getArg(args, "--wave", "sine");
+    if (wave != "sine" && wave != "saw" && wave != "square")
+    {
+        fprintf(stderr, "unknown wave %s\n", wave.c_str());
+        return 1;
+    }
+    const unsigned seed = (unsigned)atoi(getArg(args, "--seed", "1"));
+
+    int threadCount = atoi(getArg(args, "--threads", "0"));
+    if (threadCount <= 0)
+        threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+
+    // there is no FLAC encoder in the tree, so anything but WAV is refused rather than mislabelled
+    if (path.size() < 4 || path.compare(path.size() - 4, 4, ".wav") != 0)
+    {
+        fprintf(stderr, "only .wav output is supported\n");
+        return 1;
+    }
+
+    WavWriter::SampleFormat format = WavWriter::PCM_24;
+    if (bits == 16)
+        format = WavWriter::PCM_16;
+    else if (bits == 32)
+        format = WavWriter::FLOAT_32;
+
+    WavWriter writer;
+    if (!writer.open(path, sampleRate, channelsCount, format))
+    {
+        fprintf(stderr, "cannot open %s\n", path.c_str());
+        return 1;
+    }
+
+    CAKernel kernel(gridSize);
+    kernel.setThreadCount(threadCount);
+    kernel.setBandsCount(bandsCount);
+    const int cellsCount = kernel.getCellsCount();
+
+    // the bank's cells are either the grid's cells or its bands
+    const int sourcesCount = (bandsCount > 0) ? bandsCount : cellsCount;
+    std::unique_ptr<OscillatorBank> bank;
+    if (spectral)
+        bank.reset(new SpectralSynth(sourcesCount, voicesCount, sampleRate));
+    else
+        bank.reset(new OscillatorBank(sourcesCount, voicesCount, sampleRate));
+    bank->setThreadCount(threadCount);
+    bank->setLayout(SpeakerLayout(layout));
+    if (hasArg(args, "--no-multirate"))
+        bank->setMultirateEnabled(false);
+    if (wave != "sine")
+        bank->setWavetable(1, Wavetable(wave == "saw" ? Wavetable::SHAPE_SAW : Wavetable::SHAPE_SQUARE));
+
+    // the same start as pressing 'r' in the app: random life and log uniform frequencies
+    srand(seed);
+    const CARule& rule = kernel.getRule();
+    for (int v = 0; v < cellsCount; ++v)
+    {
+        float amp = (float)rand() / RAND_MAX;
+        float freq = (float)pow(2.0, log2(rule.lowestFreq) + (log2(rule.highestFreq) - log2(rule.lowestFreq)) * ((double)rand() / RAND_MAX));
+        kernel.setCell(v / gridSize, v % gridSize, amp, freq);
+    }
+
+    // bands only exist once the kernel has swept the grid, so band renders start on the first generation
+    uint64_t generations = 0;
+    if (bandsCount > 0)
+    {
+        kernel.step();
+        ++generations;
+    }
+
+    // a band's amplitude is the root of its cells' summed powers, so the same norm keeps both modes equally loud
+    const float norm = 1.0f / cellsCount;
+    std::vector<float> amps(sourcesCount);
+    std::vector<float> freqs(sourcesCount);
+    for (int v = 0; v < sourcesCount; ++v)
+    {
+        amps[v] = (bandsCount > 0) ? kernel.getBandAmps()[v] : kernel.getAmps()[v];
+        freqs[v] = (bandsCount > 0) ? kernel.getBandFreqs()[v] : kernel.getFreqs()[v];
+
+        VoiceEvent event;
+        event.cell = v;
+        event.rampFrames = 0;
+        event.frame = 0;
+
+        if (bandsCount > 0)
+        {
+            event.type = VoiceEvent::PAN;
+            event.value = (v + 0.5f) / bandsCount;
+            bank->apply(event);
+        }
+        event.type = VoiceEvent::WAVE;
+        event.value = (wave != "sine") ? 1.0f : 0.0f;
+        bank->apply(event);
+        event.type = VoiceEvent::FREQ;
+        event.value = freqs[v];
+        bank->apply(event);
+        event.type = VoiceEvent::GAIN;
+        event.value = amps[v] * norm;
+        bank->apply(event);
+    }
+
+    const bool normalise = hasArg(args, "--normalise");
+    LoudnessControl loudness(sampleRate);
+    loudness.setVoicePower(kernel.getAmpSquaredSum() * norm * norm);
+
+    // multirate output lags by a fixed number of frames, which are rendered and dropped so the file starts on time
+    const size_t latency = bank->isMultirateEnabled() ? bank->getMultirateLatency() : 0;
+    const uint64_t totalFrames = (uint64_t)(seconds * sampleRate + 0.5);
+    const size_t stepFrames = std::max<size_t>(1, (size_t)(STEP_TIME * sampleRate + 0.5));
+    const uint32_t rampFrames = (uint32_t)(ATTACK_TIME * sampleRate + 0.5);
+
+    std::vector<float> buffers(blockFrames * channelsCount);
+    std::vector<float*> channels(channelsCount);
+    for (int channel = 0; channel < channelsCount; ++channel)
+        channels[channel] = &buffers[channel * blockFrames];
+    size_t framesUntilStep = stepFrames;
+    size_t skipFrames = latency;
+    uint64_t renderedFrames = 0;
+    float peak = 0.0f;
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::duration engineTime = Clock::duration::zero();
+    const Clock::time_point start = Clock::now();
+
+    while (renderedFrames < totalFrames)
+    {
+        const Clock::time_point blockStart = Clock::now();
+
+        if (framesUntilStep == 0)
+        {
+            kernel.step();
+            ++generations;
+            framesUntilStep = stepFrames;
+            loudness.setVoicePower(kernel.getAmpSquaredSum() * norm * norm);
+
+            // like Cell, only cells whose values changed send anything
+            const float* nextAmps = (bandsCount > 0) ? kernel.getBandAmps() : kernel.getAmps();
+            const float* nextFreqs = (bandsCount > 0) ? kernel.getBandFreqs() : kernel.getFreqs();
+            VoiceEvent event;
+            event.frame = bank->getFrame();
+            event.rampFrames = rampFrames;
+            for (int v = 0; v < sourcesCount; ++v)
+            {
+                event.cell = v;
+                if (nextFreqs[v] != freqs[v])
+                {
+                    freqs[v] = nextFreqs[v];
+                    event.type = VoiceEvent::FREQ;
+                    event.value = freqs[v];
+                    bank->apply(event);
+                }
+                if (nextAmps[v] != amps[v])
+                {
+                    amps[v] = nextAmps[v];
+                    event.type = VoiceEvent::GAIN;
+                    event.value = amps[v] * norm;
+                    bank->apply(event);
+                }
+            }
+        }
+
+        size_t frames = std::min(blockFrames, framesUntilStep);
+        if (skipFrames == 0)
+            frames = (size_t)std::min<uint64_t>(frames, totalFrames - renderedFrames);
+        else
+            frames = std::min(frames, skipFrames);
+
+        std::fill(buffers.begin(), buffers.end(), 0.0f);
+        bank->render(channels.data(), frames);
+        if (normalise)
+            loudness.process(channels.data(), channelsCount, frames);
+        framesUntilStep -= frames;
+
+        engineTime += Clock::now() - blockStart;
+
+        if (skipFrames > 0)
+        {
+            skipFrames -= frames;
+            continue;
+        }
+
+        for (int channel = 0; channel < channelsCount; ++channel)
+            for (size_t k = 0; k < frames; ++k)
+                peak = std::max(peak, fabsf(channels[channel][k]));
+
+        if (!writer.write(channels.data(), frames))
+        {
+            fprintf(stderr, "write to %s failed\n", path.c_str());
+            return 1;
+        }
+        renderedFrames += frames;
+    }
+
+    if (!writer.close())
+    {
+        fprintf(stderr, "closing %s failed\n", path.c_str());
+        return 1;
+    }
+
+    const double wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    const double engineSeconds = std::chrono::duration<double>(engineTime).count();
+    const double audioSeconds = (double)renderedFrames / sampleRate;
+
+    printf("%s: %.2f s, %d cells", path.c_str(), audioSeconds, cellsCount);
+    if (bandsCount > 0)
+        printf(" in %d bands", bandsCount);
+    printf(", %llu generations, peak %.1f dBFS", (unsigned long long)generations,
+           20.0 * log10(std::max(peak, 1e-9f)));
+    if (writer.getClippedCount() > 0)
+        printf(", %llu samples clipped", (unsigned long long)writer.getClippedCount());
+    printf("\n");
+    printf("rendered in %.3f s (engine %.3f s): %.1fx realtime, engine alone %.1fx\n",
+           wallSeconds, engineSeconds,
+           audioSeconds / std::max(wallSeconds, 1e-9), audioSeconds / std::max(engineSeconds, 1e-9));
+
+    return 0;
+}
@@ -0,0 +1,1705 @@
+//
+//  OscillatorBank.cpp
+//  CASynthesis
+//
+//
+
+#include "OscillatorBank.h"
+
+#include <math.h>
+#include <algorithm>
+#include <utility>
+
+const int64_t OscillatorBank::NO_PENDING;
+const int OscillatorBank::LANES;
+const int OscillatorBank::MAX_SPLITS;
+const int OscillatorBank::MAX_CONTROL_FRAMES;
+const size_t OscillatorBank::MIN_CONTROL_SAMPLES;
+const int OscillatorBank::MULTIRATE_STAGES;
+const int OscillatorBank::HALFBAND_TAPS;
+const int OscillatorBank::MULTIRATE_HISTORY;
+const uint32_t OscillatorBank::MULTIRATE_FADE_FRAMES;
+const uint32_t OscillatorBank::PRUNE_FADE_FRAMES;
+const size_t OscillatorBank::MULTIRATE_ALIGN_FRAMES;
+const uint8_t OscillatorBank::NO_RATE;
+const size_t OscillatorBank::MULTIRATE_MAX_FRAMES;
+const size_t OscillatorBank::ENCODE_MAX_FRAMES;
+const int OscillatorBank::THRESHOLD_STEPS_PER_OCTAVE;
+const int OscillatorBank::THRESHOLD_OCTAVES;
+const size_t OscillatorBank::PARALLEL_MIN_VOICE_FRAMES;
+const size_t OscillatorBank::PARALLEL_MAX_FRAMES;
+const int OscillatorBank::MAX_WAVETABLES;
+
+// a decimated rate takes voices below this fraction of its sample rate, leaving the half band filter room to fall;
+// a voice only moves down to it once it is clear of the limit by the hysteresis
+static const float MULTIRATE_PASSBAND = 0.35f;
+static const float MULTIRATE_HYSTERESIS = 0.9f;
+
+// a voice is only pruned if it fits this fraction of its band's budget, and heard again once it no longer fits at all
+static const float PRUNING_HYSTERESIS = 0.5f;
+
+static double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; ++k)
+    {
+        term *= (x * 0.5 / k) * (x * 0.5 / k);
+        sum += term;
+    }
+    return sum;
+}
+
+OscillatorBank::OscillatorBank(int cellsCount, int voicesCount, double sampleRate)
+{
+    mSampleRate = sampleRate;
+    mFrame = 0;
+    mGridWidth = 0;
+    mTransposition = 1.0f;
+    mTranspositionStart = 1.0f;
+    mTranspositionTarget = 1.0f;
+    mTranspositionFrames = 0;
+    mTranspositionLength = 0;
+    mGlideShape = GLIDE_EXPONENTIAL;
+    mSineAccuracy = fastsine::ACCURACY_MEDIUM;
+    mRampShape = RAMP_LINEAR;
+    mControlFrames = 16;
+
+    mPruningEnabled = true;
+    mFullScaleSPL = 96.0f;
+    mPrunedCount = 0;
+    updateThresholds();
+
+    mMultirateEnabled = true;
+    mDelaying = false;
+    mDecimating = false;
+    mDecimatedCount = 0;
+    resetMultirate();
+
+    mSplitsCount = 0;
+    mBlockFrames = 0;
+    mPartitions.resize(1);
+    mWavetables.resize(MAX_WAVETABLES);
+
+    resize(cellsCount, voicesCount);
+}
+
+void OscillatorBank::resize(int cellsCount, int voicesCount)
+{
+    if (voicesCount <= 0)
+        voicesCount = cellsCount;
+
+    mFreq.assign(voicesCount, 0.0f);
+    mFreqTarget.assign(voicesCount, 0.0f);
+    mFreqStart.assign(voicesCount, 0.0f);
+    mFreqRampLength.assign(voicesCount, 0);
+    mFreqRampShape.assign(voicesCount, RAMP_LINEAR);
+    mFreqRampFrames.assign(voicesCount, 0);
+    mFreqExponential.assign(voicesCount, 0);
+    mPhase.assign(voicesCount, 0.0f);
+    mGain.assign(voicesCount, 0.0f);
+    mGainTarget.assign(voicesCount, 0.0f);
+    mGainStart.assign(voicesCount, 0.0f);
+    mRampLength.assign(voicesCount, 0);
+    mGainRampShape.assign(voicesCount, RAMP_LINEAR);
+    mRampFrames.assign(voicesCount, 0);
+    mVoiceBus.assign(voicesCount, 0);
+    mPanFirst.assign(voicesCount, (float)M_SQRT1_2);
+    mPanSecond.assign(voicesCount, (float)M_SQRT1_2);
+    mVoiceWave.assign(voicesCount, 0);
+    mWaveFade.assign(voicesCount, 0);
+
+    mPendingFrame.assign(voicesCount, NO_PENDING);
+    mPendingFreq.assign(voicesCount, -1.0f);
+    mPendingFreqRampFrames.assign(voicesCount, 0);
+    mPendingGain.assign(voicesCount, -1.0f);
+    mPendingRampFrames.assign(voicesCount, 0);
+
+    mCellFreq.assign(cellsCount, 0.0f);
+    mCellBus.assign(cellsCount, 0);
+    mCellPanFirst.assign(cellsCount, (float)M_SQRT1_2);
+    mCellPanSecond.assign(cellsCount, (float)M_SQRT1_2);
+    mCellWave.assign(cellsCount, 0);
+    mCellVoice.assign(cellsCount, -1);
+    updateCellPans();
+
+    mVoiceCell.assign(voicesCount, -1);
+    mActivePosition.assign(voicesCount, -1);
+    mActiveVoices.clear();
+    mActiveVoices.reserve(voicesCount);
+    mFreeVoices.resize(voicesCount);
+    for (int voice = 0; voice < voicesCount; ++voice)
+        mFreeVoices[voice] = voicesCount - 1 - voice;
+
+    // reserved here so that rendering never allocates
+    mPruned.assign(voicesCount, 0);
+    mWasPruned.assign(voicesCount, 0);
+    mPruneFade.assign(voicesCount, 0);
+    mVoiceBand.assign(voicesCount, 0);
+    mVoicePower.assign(voicesCount, 0.0f);
+    mVoiceRate.assign(voicesCount, 0);
+    mVoiceLastRate.assign(voicesCount, NO_RATE);
+    mRateFade.assign(voicesCount, 0);
+    mGhosts.clear();
+    mGhosts.reserve(2 * voicesCount);
+    mScalarVoice.assign(voicesCount, 0);
+    mScalarVoices.reserve(voicesCount);
+    reservePartitions();
+}
+
+void OscillatorBank::reservePartitions()
+{
+    // reserved here so that rendering never allocates
+    for (size_t p = 0; p < mPartitions.size(); ++p)
+    {
+        Partition& partition = mPartitions[p];
+        for (int rate = 0; rate <= MULTIRATE_STAGES; ++rate)
+        {
+            partition.steadyVoices[rate].reserve(getVoicesCount());
+            partition.glidingVoices[rate].reserve(getVoicesCount());
+        }
+        partition.tableVoices.reserve(getVoicesCount());
+        if (p > 0)
+        {
+            for (int bus = 0; bus < mLayout.getBusesCount(); ++bus)
+            {
+                partition.buffer[bus].resize(PARALLEL_MAX_FRAMES);
+                for (int rate = 1; rate <= MULTIRATE_STAGES; ++rate)
+                    partition.rateBuffer[rate][bus].resize(PARALLEL_MAX_FRAMES >> rate);
+            }
+        }
+    }
+}
+
+void OscillatorBank::setThreadCount(int threadCount)
+{
+    threadCount = std::max(threadCount, 1);
+    mWorkers.resize(threadCount);
+    mPartitions.resize(threadCount);
+    reservePartitions();
+}
+
+int OscillatorBank::getThreadCount() const
+{
+    return mWorkers.getThreadsCount();
+}
+
+void OscillatorBank::setLayout(const SpeakerLayout& layout, int gridWidth)
+{
+    mLayout = layout;
+    mGridWidth = gridWidth;
+
+    for (int bus = 0; bus < SpeakerLayout::MAX_BUSES; ++bus)
+        mEncodeBuffer[bus].assign(layout.isEncoded() && bus < layout.getBusesCount() ? ENCODE_MAX_FRAMES : 0, 0.0f);
+
+    // the ghosts' buses may no longer exist
+    mGhosts.clear();
+    resetMultirate();
+    reservePartitions();
+    updateCellPans();
+    updateLayout();
+}
+
+const SpeakerLayout& OscillatorBank::getLayout() const
+{
+    return mLayout;
+}
+
+int OscillatorBank::getChannelsCount() const
+{
+    return mLayout.getChannelsCount();
+}
+
+void OscillatorBank::setCellPan(int cell, const SpeakerGains& gains)
+{
+    mCellBus[cell] = gains.bus;
+    mCellPanFirst[cell] = gains.first;
+    mCellPanSecond[cell] = gains.second;
+
+    int voice = mCellVoice[cell];
+    if (voice >= 0)
+    {
+        mVoiceBus[voice] = gains.bus;
+        mPanFirst[voice] = gains.first;
+        mPanSecond[voice] = gains.second;
+    }
+}
+
+void OscillatorBank::updateCellPans()
+{
+    const int cellsCount = getCellsCount();
+    if (cellsCount == 0)
+        return;
+
+    // the centre of every cell, x across and y towards the top of the grid
+    const int width = (mGridWidth > 0) ? mGridWidth : std::max(1, (int)(sqrt((double)cellsCount) + 0.5));
+    const int columns = (cellsCount + width - 1) / width;
+    for (int cell = 0; cell < cellsCount; ++cell)
+    {
+        float x = 2.0f * (cell / width + 0.5f) / columns - 1.0f;
+        float y = 1.0f - 2.0f * (cell % width + 0.5f) / width;
+        setCellPan(cell, mLayout.getGains(x, y));
+    }
+}
+
+void OscillatorBank::sortVoicesByBus()
+{
+    // lane groups never straddle two bus pairs, so voices of a pair have to sit next to each other
+    if (mLayout.getBusesCount() <= 2)
+        return;
+
+    struct ByBus
+    {
+        const int* bus;
+        bool operator()(int a, int b) const { return bus[a] < bus[b]; }
+    };
+    ByBus byBus = { mVoiceBus.data() };
+    if (std::is_sorted(mActiveVoices.begin(), mActiveVoices.end(), byBus))
+        return;
+
+    std::sort(mActiveVoices.begin(), mActiveVoices.end(), byBus);
+    for (size_t k = 0; k < mActiveVoices.size(); ++k)
+        mActivePosition[mActiveVoices[k]] = (int)k;
+}
+
+void OscillatorBank::setWavetable(int index, const Wavetable& table)
+{
+    if (index > 0 && index < MAX_WAVETABLES)
+        mWavetables[index] = table;
+}
+
+void OscillatorBank::swapWavetable(int index, Wavetable& table)
+{
+    if (index > 0 && index < MAX_WAVETABLES)
+        std::swap(mWavetables[index], table);
+}
+
+const Wavetable& OscillatorBank::getWavetable(int index) const
+{
+    return mWavetables[index];
+}
+
+const Wavetable* OscillatorBank::getVoiceTable(int voice) const
+{
+    const Wavetable& table = mWavetables[mVoiceWave[voice]];
+    return table.isEmpty() ? NULL : &table;
+}
+
+int OscillatorBank::getCellsCount() const
+{
+    return (int)mCellVoice.size();
+}
+
+int OscillatorBank::getVoicesCount() const
+{
+    return (int)mFreq.size();
+}
+
+int OscillatorBank::getActiveVoicesCount() const
+{
+    return (int)mActiveVoices.size();
+}
+
+double OscillatorBank::getSampleRate() const
+{
+    return mSampleRate;
+}
+
+void OscillatorBank::setSampleRate(double sampleRate)
+{
+    mSampleRate = sampleRate;
+}
+
+OscillatorBank::GlideShape OscillatorBank::getGlideShape() const
+{
+    return mGlideShape;
+}
+
+void OscillatorBank::setGlideShape(GlideShape shape)
+{
+    mGlideShape = shape;
+}
+
+fastsine::Accuracy OscillatorBank::getSineAccuracy() const
+{
+    return mSineAccuracy;
+}
+
+void OscillatorBank::setSineAccuracy(fastsine::Accuracy accuracy)
+{
+    mSineAccuracy = accuracy;
+}
+
+OscillatorBank::RampShape OscillatorBank::getRampShape() const
+{
+    return mRampShape;
+}
+
+void OscillatorBank::setRampShape(RampShape shape)
+{
+    mRampShape = shape;
+}
+
+size_t OscillatorBank::getControlFrames() const
+{
+    return mControlFrames;
+}
+
+void OscillatorBank::setControlFrames(size_t frames)
+{
+    mControlFrames = std::min(std::max<size_t>(frames, 1), (size_t)MAX_CONTROL_FRAMES);
+}
+
+bool OscillatorBank::isPruningEnabled() const
+{
+    return mPruningEnabled;
+}
+
+void OscillatorBank::setPruningEnabled(bool enabled)
+{
+    mPruningEnabled = enabled;
+}
+
+float OscillatorBank::getFullScaleSPL() const
+{
+    return mFullScaleSPL;
+}
+
+void OscillatorBank::setFullScaleSPL(float spl)
+{
+    mFullScaleSPL = spl;
+    updateThresholds();
+}
+
+int OscillatorBank::getPrunedCount() const
+{
+    return mPrunedCount;
+}
+
+void OscillatorBank::updateThresholds()
+{
+    using namespace psychoacoustics;
+
+    const int steps = THRESHOLD_OCTAVES * THRESHOLD_STEPS_PER_OCTAVE + 1;
+    mQuietPower.resize(steps);
+    mQuietBand.resize(steps);
+    mBandQuietPower.assign(BARK_BANDS, 1.0f);
+    for (int k = 0; k < steps; ++k)
+    {
+        float freq = 20.0f * exp2f((float)k / THRESHOLD_STEPS_PER_OCTAVE);
+        mQuietPower[k] = powf(10.0f, (absoluteThreshold(freq) - mFullScaleSPL) / 10.0f);
+        mQuietBand[k] = (uint8_t)std::min((int)bark(freq), BARK_BANDS - 1);
+        mBandQuietPower[mQuietBand[k]] = std::min(mBandQuietPower[mQuietBand[k]], mQuietPower[k]);
+    }
+
+    // power a tonal masker in band j casts on band b, as a fraction of its own
+    mMaskingSpread.resize(BARK_BANDS * BARK_BANDS);
+    for (int b = 0; b < BARK_BANDS; ++b)
+        for (int j = 0; j < BARK_BANDS; ++j)
+            mMaskingSpread[b * BARK_BANDS + j] = powf(10.0f, (spreading((float)(b - j)) - tonalMaskingOffset(j + 0.5f)) / 10.0f);
+}
+
+void OscillatorBank::updatePruning()
+{
+    mPrunedCount = 0;
+    for (size_t k = 0; k < mActiveVoices.size(); ++k)
+        mWasPruned[mActiveVoices[k]] = mPruned[mActiveVoices[k]];
+
+    if (!mPruningEnabled)
+    {
+        for (size_t k = 0; k < mActiveVoices.size(); ++k)
+            mPruned[mActiveVoices[k]] = 0;
+    }
+    else
+    {
+        decidePruning();
+    }
+
+    // a voice changing state fades from wherever its fade has got to, so a quick return does not jump
+    for (size_t k = 0; k < mActiveVoices.size(); ++k)
+    {
+        int voice = mActiveVoices[k];
+        if (mPruned[voice] != mWasPruned[voice])
+            mPruneFade[voice] = PRUNE_FADE_FRAMES - mPruneFade[voice];
+        mPrunedCount += mPruned[voice];
+    }
+}
+
+bool OscillatorBank::isPrunedOut(int voice) const
+{
+    return mPruned[voice] && mPruneFade[voice] == 0;
+}
+
+float OscillatorBank::getPruneFade(int voice) const
+{
+    float fade = (float)mPruneFade[voice] / PRUNE_FADE_FRAMES;
+    return mPruned[voice] ? fade : 1.0f - fade;
+}
+
+void OscillatorBank::decidePruning()
+{
+    using psychoacoustics::BARK_BANDS;
+    const float nyquist = (float)(mSampleRate * 0.5);
+    const int lastStep = (int)mQuietPower.size() - 1;
+    const float transposition = getTranspositionPeak();
+    float bandPower[BARK_BANDS] = {0.0f};
+
+    for (size_t k = 0; k < mActiveVoices.size(); ++k)
+    {
+        int voice = mActiveVoices[k];
+
+        // judged by the loudest the voice will be over the block, so onsets and pending changes are never cut
+        float level = std::max(std::max(mGain[voice], mGainTarget[voice]), mPendingGain[voice]);
+        float power = level * level;
+        float freq = mFreq[voice] * transposition;
+
+        float position = log2f(freq / 20.0f) * THRESHOLD_STEPS_PER_OCTAVE;
+        int step = (int)std::min(std::max(position, 0.0f), (float)lastStep);
+
+        mPruned[voice] = (freq >= nyquist);
+        mVoiceBand[voice] = mQuietBand[step];
+        mVoicePower[voice] = power;
+        if (!mPruned[voice])
+            bandPower[mQuietBand[step]] += power;
+    }
+
+    // the power each band can lose unnoticed
+    float budget[BARK_BANDS];
+    for (int b = 0; b < BARK_BANDS; ++b)
+    {
+        budget[b] = mBandQuietPower[b];
+        for (int j = 0; j < BARK_BANDS; ++j)
+            budget[b] += bandPower[j] * mMaskingSpread[b * BARK_BANDS + j];
+    }
+
+    // the quietest voices go first: a tiny voice is taken at once, anything else only if it still fits afterwards
+    const float tinyShare = 1.0f / 64.0f;
+    float tiny[BARK_BANDS];
+    for (int b = 0; b < BARK_BANDS; ++b)
+        tiny[b] = budget[b] * tinyShare;
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (size_t k = 0; k < mActiveVoices.size(); ++k)
+        {
+            int voice = mActiveVoices[k];
+            int band = mVoiceBand[voice];
+            float power = mVoicePower[voice];
+            float margin = mWasPruned[voice] ? 1.0f : PRUNING_HYSTERESIS;
+            if (!mPruned[voice] && power <= budget[band] * margin && (pass == 1 || power <= tiny[band] * margin))
+            {
+                mPruned[voice] = 1;
+                budget[band] -= power;
+            }
+        }
+    }
+}
+
+bool OscillatorBank::isMultirateEnabled() const
+{
+    return mMultirateEnabled;
+}
+
+void OscillatorBank::setMultirateEnabled(bool enabled)
+{
+    mMultirateEnabled = enabled;
+
+    // nothing has come out yet, so there is nothing to fade
+    if (mFrame == 0)
+    {
+        mDelayed = enabled;
+        mDelayFade = 0;
+    }
+}
+
+size_t OscillatorBank::getMultirateLatency() const
+{
+    return mMultirateEnabled ? getRateHistory(0) : 0;
+}
+
+size_t OscillatorBank::getLatency() const
+{
+    return getMultirateLatency();
+}
+
+int OscillatorBank::getDecimatedCount() const
+{
+    return mDecimatedCount;
+}
+
+size_t OscillatorBank::getRateHistory(int rate)
+{
+    // the filter's history at the lowest rate; above it, a delay as long as everything upsampled into that rate
+    if (rate == MULTIRATE_STAGES)
+        return MULTIRATE_HISTORY;
+    return ((1 << (MULTIRATE_STAGES - rate)) - 1) * MULTIRATE_HISTORY;
+}
+
+void OscillatorBank::resetMultirate()
+{
+    // odd taps of a Kaiser windowed sinc at a quarter of the output rate, scaled for the gain of two zero stuffing needs
+    const double beta = 7.0;
+    double sum = 0.0;
+    for (int t = 0; t < HALFBAND_TAPS; ++t)
+    {
+        double n = 2 * t + 1;
+        double x = n / (2 * HALFBAND_TAPS);
+        double window = besselI0(beta * sqrt(1.0 - x * x)) / besselI0(beta);
+        mHalfband[t] = (float)(sin(M_PI * n * 0.5) / (M_PI * n * 0.5) * window);
+        sum += 2.0 * mHalfband[t];
+    }
+    for (int t = 0; t < HALFBAND_TAPS; ++t)
+        mHalfband[t] = (float)(mHalfband[t] / sum);
+
+    for (int bus = 0; bus < SpeakerLayout::MAX_BUSES; ++bus)
+    {
+        const bool used = bus < mLayout.getBusesCount();
+        for (int rate = 0; rate <= MULTIRATE_STAGES; ++rate)
+            mRateInput[rate][bus].assign(used ? getRateHistory(rate) + (MULTIRATE_MAX_FRAMES >> rate) : 0, 0.0f);
+        for (int rate = 1; rate < MULTIRATE_STAGES; ++rate)
+            mRateMix[rate][bus].assign(used ? MULTIRATE_HISTORY + (MULTIRATE_MAX_FRAMES >> rate) : 0, 0.0f);
+        mFadeMix[bus].assign(used ? MULTIRATE_MAX_FRAMES : 0, 0.0f);
+        mCarry[bus].assign(used ? MULTIRATE_ALIGN_FRAMES : 0, 0.0f);
+    }
+
+    mDelayed = mMultirateEnabled;
+    mDelayFade = 0;
+    mCarryFrames = 0;
+}
+
+void OscillatorBank::updateDelay()
+{
+    // either way a fade turns back from wherever it has got to
+    if (mMultirateEnabled && !mDelayed)
+    {
+        // the decimated rates last ran when multirate was turned off and may still hold the tail of that
+        for (int bus = 0; bus < mLayout.getBusesCount(); ++bus)
+        {
+            for (int rate = 1; rate <= MULTIRATE_STAGES; ++rate)
+                std::fill(mRateInput[rate][bus].begin(), mRateInput[rate][bus].end(), 0.0f);
+            for (int rate = 1; rate < MULTIRATE_STAGES; ++rate)
+                std::fill(mRateMix[rate][bus].begin(), mRateMix[rate][bus].end(), 0.0f);
+        }
+        mDelayed = true;
+        mDelayFade = MULTIRATE_FADE_FRAMES - mDelayFade;
+    }
+    else if (!mMultirateEnabled && mDelayed && mDecimatedCount == 0)
+    {
+        bool decimatedGhosts = false;
+        for (size_t g = 0; g < mGhosts.size(); ++g)
+            decimatedGhosts = decimatedGhosts || mGhosts[g].rate > 0;
+
+        if (!decimatedGhosts)
+        {
+            mDelayed = false;
+            mDelayFade = MULTIRATE_FADE_FRAMES - mDelayFade;
+        }
+    }
+
+    mDelaying = mDelayed || mDelayFade > 0;
+    mDecimating = mMultirateEnabled && mDelayed && mDelayFade == 0;
+}
+
+void OscillatorBank::updateRates(int64_t blockEnd)
+{
+    const float transposition = getTranspositionPeak();
+    mDecimatedCount = 0;
+
+    for (size_t k = 0; k < mActiveVoices.size(); ++k)
+    {
+        int voice = mActiveVoices[k];
+        int64_t pending = mPendingFrame[voice];
+        bool pendingInBlock = (pending != NO_PENDING && pending < blockEnd);
+        bool audible = !isPrunedOut(voice) && (mGain[voice] != 0.0f || mRampFrames[voice] > 0 || (pendingInBlock && mPendingGain[voice] > 0.0f));
+        int lastRate = mVoiceLastRate[voice];
+        int rate = 0;
+
+        // a table's harmonics reach up to Nyquist whatever its fundamental, so table voices never decimate
+        if (mDecimating && audible && !mScalarVoice[voice] && getVoiceTable(voice) == NULL)
+        {
+            // a glide is monotonic, so the highest frequency it reaches over the block is one of its ends
+            float freq = std::max(mFreq[voice], mFreqTarget[voice]);
+            if (pendingInBlock)
+                freq = std::max(freq, mPendingFreq[voice]);
+            freq *= transposition;
+            while (rate < MULTIRATE_STAGES && freq < MULTIRATE_PASSBAND * (float)mSampleRate / (float)(2 << rate) * (rate >= lastRate ? MULTIRATE_HYSTERESIS : 1.0f))
+                ++rate;
+        }
+
+        if (!mDelaying || !audible)
+        {
+            mRateFade[voice] = 0;
+            lastRate = NO_RATE;
+        }
+        else if (lastRate != NO_RATE && lastRate != rate && mGhosts.size() < mGhosts.capacity())
+        {
+            pushGhost(voice, lastRate);
+            mRateFade[voice] = MULTIRATE_FADE_FRAMES;
+        }
+
+        mVoiceRate[voice] = (uint8_t)rate;
+        mVoiceLastRate[voice] = audible ? (uint8_t)rate : NO_RATE;
+        mDecimatedCount += (rate > 0);
+    }
+}
+
+float OscillatorBank::getRateFade(int voice) const
+{
+    return 1.0f - (float)mRateFade[voice] / MULTIRATE_FADE_FRAMES;
+}
+
+void OscillatorBank::skipRateFade(int voice, size_t frames)
+{
+    mRateFade[voice] = (mRateFade[voice] > frames) ? mRateFade[voice] - (uint32_t)frames : 0;
+}
+
+float OscillatorBank::getVoiceFade(int voice) const
+{
+    return getRateFade(voice) * getPruneFade(voice) * (1.0f - (float)mWaveFade[voice] / MULTIRATE_FADE_FRAMES);
+}
+
+void OscillatorBank::skipVoiceFades(int voice, size_t frames)
+{
+    skipRateFade(voice, frames);
+    mPruneFade[voice] = (mPruneFade[voice] > frames) ? mPruneFade[voice] - (uint32_t)frames : 0;
+    mWaveFade[voice] = (mWaveFade[voice] > frames) ? mWaveFade[voice] - (uint32_t)frames : 0;
+}
+
+void OscillatorBank::pushGhost(int voice, int rate)
+{
+    Ghost ghost;
+    ghost.rate = rate;
+    ghost.wave = mVoiceWave[voice];
+    ghost.freq = mFreq[voice] * mTransposition;
+    ghost.phase = mPhase[voice];
+    ghost.gain = mGain[voice] * getVoiceFade(voice);
+    ghost.bus = mVoiceBus[voice];
+    ghost.panFirst = mPanFirst[voice];
+    ghost.panSecond = mPanSecond[voice];
+    ghost.fadeFrames = MULTIRATE_FADE_FRAMES;
+    mGhosts.push_back(ghost);
+}
+
+void OscillatorBank::renderGhosts(float* const* buses)
+{
+    for (size_t g = 0; g < mGhosts.size();)
+    {
+        Ghost& ghost = mGhosts[g];
+        if (ghost.rate > 0 && !mDelaying)
+            ghost.fadeFrames = 0;
+
+        const int decimation = 1 << ghost.rate;
+        const size_t samples = std::min<size_t>(mBlockFrames, ghost.fadeFrames) / decimation;
+        const float increment = ghost.freq * decimation / (float)mSampleRate;
+        const float fadeStep = (float)decimation / MULTIRATE_FADE_FRAMES;
+        const int nextBus = mLayout.getNextBus(ghost.bus);
+        float* first = (ghost.rate == 0) ? buses[ghost.bus] : &mRateInput[ghost.rate][ghost.bus][getRateHistory(ghost.rate)];
+        float* second = (ghost.rate == 0) ? buses[nextBus] : &mRateInput[ghost.rate][nextBus][getRateHistory(ghost.rate)];
+
+        const Wavetable& table = mWavetables[ghost.wave];
+        const float* tableSamples = table.isEmpty() ? NULL : table.getSamples(Wavetable::getLevel(increment));
+
+        float fade = (float)ghost.fadeFrames / MULTIRATE_FADE_FRAMES;
+        for (size_t k = 0; k < samples; ++k)
+        {
+            float wave = (tableSamples != NULL) ? Wavetable::lookup(tableSamples, ghost.phase) : fastsine::sin2pi<fastsine::ACCURACY_HIGH>(ghost.phase);
+            float sample = ghost.gain * fade * wave;
+            first[k] += sample * ghost.panFirst;
+            second[k] += sample * ghost.panSecond;
+            fade -= fadeStep;
+            ghost.phase += increment;
+            ghost.phase -= floorf(ghost.phase);
+        }
+        ghost.fadeFrames -= (uint32_t)(samples * decimation);
+
+        if (ghost.fadeFrames == 0)
+        {
+            ghost = mGhosts.back();
+            mGhosts.pop_back();
+        }
+        else
+        {
+            ++g;
+        }
+    }
+}
+
+void OscillatorBank::upsample(const float* input, size_t count, const float* taps, float* output)
+{
+    // output trails input by MULTIRATE_HISTORY output samples: odd outputs copy an input, even ones fall halfway
+    // between two; the MULTIRATE_HISTORY samples before input are read as history
+    for (size_t j = 0; j < count; ++j)
+    {
+        const float* center = input + j - HALFBAND_TAPS;
+        float sum = 0.0f;
+        for (int t = 0; t < HALFBAND_TAPS; ++t)
+            sum += taps[t] * (center[-t] + center[t + 1]);
+        output[2 * j] += sum;
+        output[2 * j + 1] += center[1];
+    }
+}
+
+void OscillatorBank::mixMultirate(float* const* buses, size_t partitionsCount)
+{
+    const float fadeStep = 1.0f / MULTIRATE_FADE_FRAMES;
+
+    for (int channel = 0; channel < mLayout.getBusesCount(); ++channel)
+    {
+        const float* direct = &mRateInput[0][channel][getRateHistory(0)];
+
+        if (mDelaying)
+        {
+            for (int rate = 1; rate <= MULTIRATE_STAGES; ++rate)
+            {
+                float* input = &mRateInput[rate][channel][getRateHistory(rate)];
+                for (size_t p = 1; p < partitionsCount; ++p)
+                {
+                    const float* rendered = &mPartitions[p].rateBuffer[rate][channel][0];
+                    for (size_t k = 0; k < (mBlockFrames >> rate); ++k)
+                        input[k] += rendered[k];
+                }
+            }
+
+            float* output = buses[channel];
+            if (mDelayFade > 0)
+            {
+                output = &mFadeMix[channel][0];
+                std::fill(output, output + mBlockFrames, 0.0f);
+            }
+
+            // from the lowest rate up: each rate's own voices, delayed, plus the rate below upsampled into it
+            for (int rate = MULTIRATE_STAGES - 1; rate >= 0; --rate)
+            {
+                const size_t samples = mBlockFrames >> rate;
+                const float* delayed = &mRateInput[rate][channel][0];
+                const float* below = (rate + 1 == MULTIRATE_STAGES) ? &mRateInput[rate + 1][channel][MULTIRATE_HISTORY] : &mRateMix[rate + 1][channel][MULTIRATE_HISTORY];
+                float* mix = (rate == 0) ? output : &mRateMix[rate][channel][MULTIRATE_HISTORY];
+
+                if (rate > 0)
+                    std::fill(mix, mix + samples, 0.0f);
+                for (size_t k = 0; k < samples; ++k)
+                    mix[k] += delayed[k];
+                upsample(below, samples / 2, mHalfband, mix);
+            }
+
+            // the output being left fades out as the one mDelayed picks fades in
+            if (mDelayFade > 0)
+            {
+                float fade = (float)mDelayFade / MULTIRATE_FADE_FRAMES;
+                for (size_t k = 0; k < mBlockFrames; ++k)
+                {
+                    float delayedGain = mDelayed ? 1.0f - fade : fade;
+                    buses[channel][k] += delayedGain * output[k] + (1.0f - delayedGain) * direct[k];
+                    fade = std::max(fade - fadeStep, 0.0f);
+                }
+            }
+
+            for (int rate = 1; rate <= MULTIRATE_STAGES; ++rate)
+            {
+                std::vector<float>& input = mRateInput[rate][channel];
+                std::copy(input.begin() + (mBlockFrames >> rate), input.begin() + (mBlockFrames >> rate) + getRateHistory(rate), input.begin());
+            }
+            for (int rate = 1; rate < MULTIRATE_STAGES; ++rate)
+            {
+                std::vector<float>& mix = mRateMix[rate][channel];
+                std::copy(mix.begin() + (mBlockFrames >> rate), mix.begin() + (mBlockFrames >> rate) + MULTIRATE_HISTORY, mix.begin());
+            }
+        }
+        else
+        {
+            for (size_t k = 0; k < mBlockFrames; ++k)
+                buses[channel][k] += direct[k];
+        }
+
+        // the full rate delay line keeps running either way, so a crossfade always has both outputs to go between
+        std::vector<float>& input = mRateInput[0][channel];
+        std::copy(input.begin() + mBlockFrames, input.begin() + mBlockFrames + getRateHistory(0), input.begin());
+    }
+
+    mDelayFade = (mDelayFade > mBlockFrames) ? mDelayFade - (uint32_t)mBlockFrames : 0;
+}
+
+void OscillatorBank::renderAligned(float* const* buses, size_t frames)
+{
+    const int busesCount = mLayout.getBusesCount();
+
+    const size_t carried = std::min(frames, mCarryFrames);
+    float* rest[SpeakerLayout::MAX_BUSES];
+    for (int bus = 0; bus < busesCount; ++bus)
+    {
+        for (size_t k = 0; k < carried; ++k)
+            buses[bus][k] += mCarry[bus][k];
+        std::copy(mCarry[bus].begin() + carried, mCarry[bus].begin() + mCarryFrames, mCarry[bus].begin());
+        rest[bus] = buses[bus] + carried;
+    }
+    mCarryFrames -= carried;
+    frames -= carried;
+
+    const size_t whole = frames - frames % MULTIRATE_ALIGN_FRAMES;
+    if (whole > 0)
+        OscillatorBank::renderBuses(rest, whole);
+
+    const size_t left = frames - whole;
+    if (left > 0)
+    {
+        float* ahead[SpeakerLayout::MAX_BUSES];
+        for (int bus = 0; bus < busesCount; ++bus)
+        {
+            std::fill(mCarry[bus].begin(), mCarry[bus].end(), 0.0f);
+            ahead[bus] = &mCarry[bus][0];
+        }
+        OscillatorBank::renderBuses(ahead, MULTIRATE_ALIGN_FRAMES);
+
+        for (int bus = 0; bus < busesCount; ++bus)
+        {
+            for (size_t k = 0; k < left; ++k)
+                rest[bus][whole + k] += mCarry[bus][k];
+            std::copy(mCarry[bus].begin() + left, mCarry[bus].end(), mCarry[bus].begin());
+        }
+        mCarryFrames = MULTIRATE_ALIGN_FRAMES - left;
+    }
+}
+
+int64_t OscillatorBank::getFrame() const
+{
+    return mFrame;
+}
+
+void OscillatorBank::setFrame(int64_t frame)
+{
+    mFrame = frame;
+}
+
+float OscillatorBank::shapeRamp(float progress, uint8_t shape)
+{
+    // smooth ramps follow smoothstep, which leaves and arrives with zero slope
+    return (shape == RAMP_SMOOTH) ? progress * progress * (3.0f - 2.0f * progress) : progress;
+}
+
+void OscillatorBank::setTransposition(float ratio, uint32_t glideFrames)
+{
+    if (ratio <= 0.0f)
+        return;
+
+    mTranspositionStart = mTransposition;
+    mTranspositionTarget = ratio;
+    mTranspositionFrames = glideFrames;
+    mTranspositionLength = glideFrames;
+    if (glideFrames == 0)
+        mTransposition = ratio;
+}
+
+float OscillatorBank::getTransposition() const
+{
+    return mTransposition;
+}
+
+float OscillatorBank::getTranspositionAt(size_t frames) const
+{
+    if (frames >= mTranspositionFrames)
+        return mTranspositionTarget;
+    if (frames == 0)
+        return mTransposition;
+
+    float progress = 1.0f - (float)(mTranspositionFrames - frames) / mTranspositionLength;
+    return mTranspositionStart * powf(mTranspositionTarget / mTranspositionStart, progress);
+}
+
+float OscillatorBank::getTranspositionPeak() const
+{
+    return std::max(mTransposition, mTranspositionTarget);
+}
+
+void OscillatorBank::skipTransposition(size_t frames)
+{
+    mTransposition = getTranspositionAt(frames);
+    mTranspositionFrames = (mTranspositionFrames > frames) ? mTranspositionFrames - (uint32_t)frames : 0;
+}
+
+void OscillatorBank::rampGain(int voice, float gain, uint32_t rampFrames)
+{
+    mGainTarget[voice] = gain;
+    if (rampFrames == 0)
+    {
+        mGain[voice] = gain;
+        mRampFrames[voice] = 0;
+    }
+    else
+    {
+        mGainStart[voice] = mGain[voice];
+        mGainRampShape[voice] = mRampShape;
+        mRampLength[voice] = rampFrames;
+        mRampFrames[voice] = rampFrames;
+    }
+}
+
+void OscillatorBank::glideFreq(int voice, float freq, uint32_t rampFrames)
+{
+    const float from = mFreq[voice];
+    mFreqTarget[voice] = freq;
+
+    // an exponential glide needs two positive ends, anything else jumps; so does a silent voice, which would
+    // otherwise chirp up from its old frequency as it fades back in
+    bool exponential = (mGlideShape == GLIDE_EXPONENTIAL);
+    bool silent = (mGain[voice] == 0.0f && mRampFrames[voice] == 0);
+    if (rampFrames == 0 || from == freq || silent || (exponential && (from <= 0.0f || freq <= 0.0f)))
+    {
+        mFreq[voice] = freq;
+        mFreqRampFrames[voice] = 0;
+    }
+    else
+    {
+        mFreqExponential[voice] = exponential;
+        mFreqStart[voice] = from;
+        mFreqRampShape[voice] = mRampShape;
+        mFreqRampLength[voice] = rampFrames;
+        mFreqRampFrames[voice] = rampFrames;
+    }
+}
+
+void OscillatorBank::skipFreqGlide(int voice, size_t frames)
+{
+    uint32_t rampFrames = mFreqRampFrames[voice];
+    if (rampFrames == 0)
+        return;
+
+    if (frames >= rampFrames)
+    {
+        mFreq[voice] = mFreqTarget[voice];
+        mFreqRampFrames[voice] = 0;
+    }
+    else
+    {
+        rampFrames -= (uint32_t)frames;
+        float progress = shapeRamp(1.0f - (float)rampFrames / mFreqRampLength[voice], mFreqRampShape[voice]);
+        float from = mFreqStart[voice];
+        float to = mFreqTarget[voice];
+        mFreq[voice] = mFreqExponential[voice] ? from * powf(to / from, progress) : from + (to - from) * progress;
+        mFreqRampFrames[voice] = rampFrames;
+    }
+}
+
+int OscillatorBank::allocateVoice(int cell, float gain)
+{
+    int voice;
+    if (!mFreeVoices.empty())
+    {
+        voice = mFreeVoices.back();
+        mFreeVoices.pop_back();
+    }
+    else
+    {
+        // steal the voice that is, or is about to be, the quietest
+        voice = -1;
+        float quietest = gain;
+        for (size_t k = 0; k < mActiveVoices.size(); ++k)
+        {
+            int candidate = mActiveVoices[k];
+            float level = std::max(std::max(mGain[candidate], mGainTarget[candidate]), mPendingGain[candidate]);
+            if (level < quietest)
+            {
+                quietest = level;
+                voice = candidate;
+            }
+        }
+        if (voice < 0)
+            return -1;
+
+        releaseStolenVoice(voice);
+        mFreeVoices.pop_back();
+    }
+
+    mVoiceCell[voice] = cell;
+    mCellVoice[cell] = voice;
+    mActivePosition[voice] = (int)mActiveVoices.size();
+    mActiveVoices.push_back(voice);
+
+    mFreq[voice] = mCellFreq[cell];
+    mFreqTarget[voice] = mCellFreq[cell];
+    mFreqRampFrames[voice] = 0;
+    mPhase[voice] = 0.0f;
+    mGain[voice] = 0.0f;
+    mGainTarget[voice] = 0.0f;
+    mRampFrames[voice] = 0;
+    mVoiceBus[voice] = mCellBus[cell];
+    mPanFirst[voice] = mCellPanFirst[cell];
+    mPanSecond[voice] = mCellPanSecond[cell];
+    mVoiceWave[voice] = mCellWave[cell];
+    mPendingFrame[voice] = NO_PENDING;
+    mPendingFreq[voice] = -1.0f;
+    mPendingGain[voice] = -1.0f;
+    mVoiceLastRate[voice] = NO_RATE;
+    mRateFade[voice] = 0;
+    mWaveFade[voice] = 0;
+    mPruned[voice] = 0;
+    mPruneFade[voice] = 0;
+
+    return voice;
+}
+
+void OscillatorBank::releaseVoice(int voice)
+{
+    mCellVoice[mVoiceCell[voice]] = -1;
+    mVoiceCell[voice] = -1;
+
+    int position = mActivePosition[voice];
+    int last = mActiveVoices.back();
+    mActiveVoices[position] = last;
+    mActivePosition[last] = position;
+    mActiveVoices.pop_back();
+    mActivePosition[voice] = -1;
+
+    mFreeVoices.push_back(voice);
+}
+
+void OscillatorBank::releaseStolenVoice(int voice)
+{
+    // the copy carries on from the start of the block at the rate the voice last rendered at
+    if (!isPrunedOut(voice) && (mGain[voice] != 0.0f || mRampFrames[voice] > 0) && mGhosts.size() < mGhosts.capacity())
+        pushGhost(voice, (mVoiceLastRate[voice] != NO_RATE) ? mVoiceLastRate[voice] : 0);
+
+    releaseVoice(voice);
+}
+
+void OscillatorBank::changeVoiceWave(int voice, int wave)
+{
+    if (mVoiceWave[voice] == wave)
+        return;
+
+    // the voice starts over on the new table as if just allocated, so it does not also crossfade its rate
+    if (!isPrunedOut(voice) && (mGain[voice] != 0.0f || mRampFrames[voice] > 0) && mGhosts.size() < mGhosts.capacity())
+    {
+        pushGhost(voice, (mVoiceLastRate[voice] != NO_RATE) ? mVoiceLastRate[voice] : 0);
+        mVoiceLastRate[voice] = NO_RATE;
+        mRateFade[voice] = 0;
+        mWaveFade[voice] = MULTIRATE_FADE_FRAMES;
+    }
+    mVoiceWave[voice] = (uint8_t)wave;
+}
+
+void OscillatorBank::recycleVoices()
+{
+    for (size_t k = 0; k < mActiveVoices.size(); )
+    {
+        int voice = mActiveVoices[k];
+        if (mGain[voice] == 0.0f && mRampFrames[voice] == 0 && mPendingFrame[voice] == NO_PENDING)
+            releaseVoice(voice);
+        else
+            ++k;
+    }
+}
+
+void OscillatorBank::skipGainRamp(int voice, size_t frames)
+{
+    uint32_t rampFrames = mRampFrames[voice];
+    if (rampFrames == 0)
+        return;
+
+    if (frames >= rampFrames)
+    {
+        mGain[voice] = mGainTarget[voice];
+        mRampFrames[voice] = 0;
+    }
+    else
+    {
+        rampFrames -= (uint32_t)frames;
+        float progress = shapeRamp(1.0f - (float)rampFrames / mRampLength[voice], mGainRampShape[voice]);
+        mGain[voice] = mGainStart[voice] + (mGainTarget[voice] - mGainStart[voice]) * progress;
+        mRampFrames[voice] = rampFrames;
+    }
+}
+
+void OscillatorBank::skipVoice(int voice, size_t begin, size_t end)
+{
+    // the phase follows the mean of the frequency line, so the voice comes back in step with where it would have been
+    const float freq = mFreq[voice] * getTranspositionAt(begin);
+    skipFreqGlide(voice, end - begin);
+    const float nextFreq = mFreq[voice] * getTranspositionAt(end);
+    const double phase = mPhase[voice] + 0.5 * (freq + nextFreq) * (end - begin) / mSampleRate;
+    mPhase[voice] = (float)(phase - floor(phase));
+
+    skipGainRamp(voice, end - begin);
+    skipVoiceFades(voice, end - begin);
+}
+
+void OscillatorBank::applyPending(int voice)
+{
+    if (mPendingFreq[voice] >= 0.0f)
+        glideFreq(voice, mPendingFreq[voice], mPendingFreqRampFrames[voice]);
+    if (mPendingGain[voice] >= 0.0f)
+        rampGain(voice, mPendingGain[voice], mPendingRampFrames[voice]);
+
+    mPendingFrame[voice] = NO_PENDING;
+    mPendingFreq[voice] = -1.0f;
+    mPendingGain[voice] = -1.0f;
+}
+
+void OscillatorBank::apply(const VoiceEvent& event)
+{
+    if (event.type == VoiceEvent::TRANSPOSE)
+    {
+        setTransposition(event.value, event.rampFrames);
+        return;
+    }
+
+    const int cell = event.cell;
+    int voice = mCellVoice[cell];
+
+    if (event.type == VoiceEvent::PAN)
+    {
+        setCellPan(cell, mLayout.getPanGains(event.value));
+        return;
+    }
+
+    if (event.type == VoiceEvent::WAVE)
+    {
+        int wave = (int)event.value;
+        mCellWave[cell] = (uint8_t)((wave > 0 && wave < MAX_WAVETABLES) ? wave : 0);
+        if (voice >= 0)
+            changeVoiceWave(voice, mCellWave[cell]);
+        return;
+    }
+
+    if (event.type == VoiceEvent::FREQ)
+        mCellFreq[cell] = event.value;
+
+    if (voice < 0)
+    {
+        // a cell without a voice is silent, so only a rising gain needs one
+        if (event.type != VoiceEvent::GAIN || event.value <= 0.0f)
+            return;
+
+        voice = allocateVoice(cell, event.value);
+        if (voice < 0)
+            return;
+    }
+
+    // an older change still waiting for its frame is brought forward rather than lost
+    if (mPendingFrame[voice] != NO_PENDING && mPendingFrame[voice] != event.frame)
+        applyPending(voice);
+
+    if (event.frame > mFrame)
+    {
+        mPendingFrame[voice] = event.frame;
+        if (event.type == VoiceEvent::FREQ)
+        {
+            mPendingFreq[voice] = event.value;
+            mPendingFreqRampFrames[voice] = event.rampFrames;
+        }
+        else
+        {
+            mPendingGain[voice] = event.value;
+            mPendingRampFrames[voice] = event.rampFrames;
+        }
+    }
+    else if (event.type == VoiceEvent::FREQ)
+    {
+        glideFreq(voice, event.value, event.rampFrames);
+    }
+    else
+    {
+        rampGain(voice, event.value, event.rampFrames);
+    }
+}
+
+void OscillatorBank::renderVoice(int voice, float* const* buses, size_t begin, size_t end)
+{
+    if (isPrunedOut(voice))
+    {
+        skipVoice(voice, begin, end);
+        return;
+    }
+    if (mGain[voice] == 0.0f && mRampFrames[voice] == 0)
+    {
+        // silent voices skip rendering but their glides still have to arrive on time
+        skipFreqGlide(voice, end - begin);
+        return;
+    }
+
+    float* first = buses[mVoiceBus[voice]];
+    float* second = buses[mLayout.getNextBus(mVoiceBus[voice])];
+    const float panFirst = mPanFirst[voice];
+    const float panSecond = mPanSecond[voice];
+    const float sampleDuration = 1.0f / (float)mSampleRate;
+    const Wavetable* table = getVoiceTable(voice);
+    float phase = mPhase[voice];
+
+    for (size_t block = begin; block < end; block += mControlFrames)
+    {
+        // ramps are evaluated at control points and interpolated linearly in between
+        const size_t blockEnd = std::min(end, block + mControlFrames);
+        const float length = (float)(blockEnd - block);
+
+        float gain = mGain[voice] * getVoiceFade(voice);
+        float freq = mFreq[voice] * getTranspositionAt(block);
+        skipGainRamp(voice, blockEnd - block);
+        skipVoiceFades(voice, blockEnd - block);
+        skipFreqGlide(voice, blockEnd - block);
+        const float gainStep = (mGain[voice] * getVoiceFade(voice) - gain) / length;
+        const float freqStep = (mFreq[voice] * getTranspositionAt(blockEnd) - freq) / length;
+
+        // the level that keeps every harmonic below Nyquist at the higher end of the line
+        const float* samples = NULL;
+        if (table != NULL)
+            samples = table->getSamples(Wavetable::getLevel(std::max(freq, freq + freqStep * length) * sampleDuration));
+
+        for (size_t k = block; k < blockEnd; ++k)
+        {
+            float sample = gain * ((samples != NULL) ? Wavetable::lookup(samples, phase) : fastsine::sin2pi<fastsine::ACCURACY_HIGH>(phase));
+            first[k] += sample * panFirst;
+            second[k] += sample * panSecond;
+            gain += gainStep;
+
+            // the phase integrates the straight frequency line exactly, whatever the sample rate
+            phase += (freq + 0.5f * freqStep) * sampleDuration;
+            if (phase >= 1.0f)
+                phase -= 1.0f;
+            freq += freqStep;
+        }
+    }
+
+    mPhase[voice] = phase;
+}
+
+int OscillatorBank::getLaneGroup(const std::vector<int>& voices, int group) const
+{
+    // up to LANES voices from \a group on that share a bus pair
+    const int bus = mVoiceBus[voices[group]];
+    const int end = std::min((int)voices.size(), group + LANES);
+    int count = 1;
+    while (group + count < end && mVoiceBus[voices[group + count]] == bus)
+        ++count;
+    return count;
+}
+
+void OscillatorBank::loadPanLanes(const int* voices, int count, float* panFirst, float* panSecond) const
+{
+    for (int l = 0; l < LANES; ++l)
+    {
+        // tail lanes are silent dummies so the lane loops never need a remainder
+        panFirst[l] = (l < count) ? mPanFirst[voices[l]] : 0.0f;
+        panSecond[l] = (l < count) ? mPanSecond[voices[l]] : 0.0f;
+    }
+}
+
+void OscillatorBank::advanceGainLanes(const int* voices, int count, size_t frames, size_t samples, float* gain, float* step)
+{
+    // the voice's state jumps \a frames ahead to the end of the sub-block; the lanes walk there linearly in \a samples
+    for (int l = 0; l < LANES; ++l)
+    {
+        if (l < count)
+        {
+            int voice = voices[l];
+            gain[l] = mGain[voice] * getVoiceFade(voice);
+            skipGainRamp(voice, frames);
+            skipVoiceFades(voice, frames);
+            step[l] = (mGain[voice] * getVoiceFade(voice) - gain[l]) / samples;
+        }
+        else
+        {
+            gain[l] = 0.0f;
+            step[l] = 0.0f;
+        }
+    }
+}
+
+void OscillatorBank::renderSteady(const std::vector<int>& steadyVoices, float* const* buses, size_t begin, size_t end, int decimation)
+{
+    const size_t length = end - begin;
+    const size_t controlSamples = (decimation == 1) ? mControlFrames : std::max<size_t>(mControlFrames / decimation, MIN_CONTROL_SAMPLES);
+    const double sampleDuration = decimation / mSampleRate;
+    const int voicesCount = (int)steadyVoices.size();
+
+    for (int group = 0, count = 0; group < voicesCount; group += count)
+    {
+        const int* voices = &steadyVoices[group];
+        count = getLaneGroup(steadyVoices, group);
+        float* first = buses[mVoiceBus[voices[0]]];
+        float* second = buses[mLayout.getNextBus(mVoiceBus[voices[0]])];
+
+        float gain[LANES], step[LANES], panFirst[LANES], panSecond[LANES];
+        float re[LANES], im[LANES], rotCos[LANES], rotSin[LANES];
+        loadPanLanes(voices, count, panFirst, panSecond);
+
+        // the phasor is reseeded from the phase accumulator on every segment, which also keeps its magnitude from drifting
+        for (int l = 0; l < LANES; ++l)
+        {
+            float phase = (l < count) ? mPhase[voices[l]] : 0.0f;
+            double angle = (l < count) ? 2.0 * M_PI * mFreq[voices[l]] * mTransposition * sampleDuration : 0.0;
+            re[l] = fastsine::cos2pi<fastsine::ACCURACY_HIGH>(phase);
+            im[l] = fastsine::sin2pi<fastsine::ACCURACY_HIGH>(phase);
+            rotCos[l] = (float)cos(angle);
+            rotSin[l] = (float)sin(angle);
+        }
+
+        for (size_t block = begin; block < end; block += controlSamples)
+        {
+            const size_t blockEnd = std::min(end, block + controlSamples);
+            advanceGainLanes(voices, count, (blockEnd - block) * decimation, blockEnd - block, gain, step);
+
+            for (size_t k = block; k < blockEnd; ++k)
+            {
+                float sumFirst = 0.0f;
+                float sumSecond = 0.0f;
+                for (int l = 0; l < LANES; ++l)
+                {
+                    float sample = gain[l] * im[l];
+                    sumFirst += sample * panFirst[l];
+                    sumSecond += sample * panSecond[l];
+                    gain[l] += step[l];
+
+                    float rotated = re[l] * rotCos[l] - im[l] * rotSin[l];
+                    im[l] = re[l] * rotSin[l] + im[l] * rotCos[l];
+                    re[l] = rotated;
+                }
+                first[k] += sumFirst;
+                second[k] += sumSecond;
+            }
+        }
+
+        for (int l = 0; l < count; ++l)
+        {
+            int voice = voices[l];
+            double phase = mPhase[voice] + mFreq[voice] * mTransposition * sampleDuration * length;
+            mPhase[voice] = (float)(phase - floor(phase));
+        }
+    }
+}
+
+void OscillatorBank::renderGliding(const std::vector<int>& glidingVoices, float* const* buses, size_t begin, size_t end, int decimation)
+{
+    switch (mSineAccuracy)
+    {
+        case fastsine::ACCURACY_LOW:
+            renderGliding<fastsine::ACCURACY_LOW>(glidingVoices, buses, begin, end, decimation);
+            break;
+        case fastsine::ACCURACY_MEDIUM:
+            renderGliding<fastsine::ACCURACY_MEDIUM>(glidingVoices, buses, begin, end, decimation);
+            break;
+        default:
+            renderGliding<fastsine::ACCURACY_HIGH>(glidingVoices, buses, begin, end, decimation);
+            break;
+    }
+}
+
+template <int Terms>
+void OscillatorBank::renderGliding(const std::vector<int>& glidingVoices, float* const* buses, size_t begin, size_t end, int decimation)
+{
+    const size_t controlSamples = (decimation == 1) ? mControlFrames : std::max<size_t>(mControlFrames / decimation, MIN_CONTROL_SAMPLES);
+    const float sampleDuration = (float)(decimation / mSampleRate);
+    const int voicesCount = (int)glidingVoices.size();
+
+    for (int group = 0, count = 0; group < voicesCount; group += count)
+    {
+        const int* voices = &glidingVoices[group];
+        count = getLaneGroup(glidingVoices, group);
+        float* first = buses[mVoiceBus[voices[0]]];
+        float* second = buses[mLayout.getNextBus(mVoiceBus[voices[0]])];
+
+        float gain[LANES], step[LANES], panFirst[LANES], panSecond[LANES];
+        float phase[LANES], freq[LANES], freqStep[LANES];
+        loadPanLanes(voices, count, panFirst, panSecond);
+
+        for (int l = 0; l < LANES; ++l)
+            phase[l] = (l < count) ? mPhase[voices[l]] : 0.0f;
+
+        for (size_t block = begin; block < end; block += controlSamples)
+        {
+            const size_t blockEnd = std::min(end, block + controlSamples);
+            const size_t samples = blockEnd - block;
+            advanceGainLanes(voices, count, samples * decimation, samples, gain, step);
+
+            // either glide shape is evaluated at the control points, so within a sub-block it is a straight line
+            const float transposition = getTranspositionAt(block * decimation);
+            const float nextTransposition = getTranspositionAt(blockEnd * decimation);
+            for (int l = 0; l < LANES; ++l)
+            {
+                if (l < count)
+                {
+                    int voice = voices[l];
+                    freq[l] = mFreq[voice] * transposition;
+                    skipFreqGlide(voice, samples * decimation);
+                    freqStep[l] = (mFreq[voice] * nextTransposition - freq[l]) / samples;
+                }
+                else
+                {
+                    freq[l] = 0.0f;
+                    freqStep[l] = 0.0f;
+                }
+            }
+
+            for (size_t k = block; k < blockEnd; ++k)
+            {
+                float sumFirst = 0.0f;
+                float sumSecond = 0.0f;
+                for (int l = 0; l < LANES; ++l)
+                {
+                    float sample = gain[l] * fastsine::sin2pi<Terms>(phase[l]);
+                    sumFirst += sample * panFirst[l];
+                    sumSecond += sample * panSecond[l];
+                    gain[l] += step[l];
+
+                    // the phase integrates the straight frequency line exactly, so every rate keeps the same phase
+                    float advanced = phase[l] + (freq[l] + 0.5f * freqStep[l]) * sampleDuration;
+                    phase[l] = (advanced >= 1.0f) ? advanced - 1.0f : advanced;
+                    freq[l] += freqStep[l];
+                }
+                first[k] += sumFirst;
+                second[k] += sumSecond;
+            }
+        }
+
+        for (int l = 0; l < count; ++l)
+            mPhase[voices[l]] = phase[l];
+    }
+}
+
+void OscillatorBank::renderSegment(Partition& partition, size_t begin, size_t end)
+{
+    const bool transposing = (mTranspositionFrames > 0);
+
+    for (int rate = 0; rate <= MULTIRATE_STAGES; ++rate)
+    {
+        partition.steadyVoices[rate].clear();
+        partition.glidingVoices[rate].clear();
+    }
+    partition.tableVoices.clear();
+
+    for (size_t k = partition.first; k < partition.last; ++k)
+    {
+        int voice = mActiveVoices[k];
+        int rate = mVoiceRate[voice];
+        if (mScalarVoice[voice])
+            continue;
+
+        if (rate > 0 && (mFreqRampFrames[voice] > 0 || transposing))
+            partition.glidingVoices[rate].push_back(voice);
+        else if (rate > 0)
+            partition.steadyVoices[rate].push_back(voice);
+        else if (isPrunedOut(voice))
+            skipVoice(voice, begin, end);
+        else if (mGain[voice] == 0.0f && mRampFrames[voice] == 0)
+            skipFreqGlide(voice, end - begin);
+        else if (getVoiceTable(voice) != NULL)
+            partition.tableVoices.push_back(voice);
+        else if (mFreqRampFrames[voice] > 0 || transposing)
+            partition.glidingVoices[0].push_back(voice);
+        else
+            partition.steadyVoices[0].push_back(voice);
+    }
+
+    // decimated rates render the segment rounded to their own samples
+    for (int rate = 0; rate <= MULTIRATE_STAGES; ++rate)
+    {
+        const size_t half = (1 << rate) >> 1;
+        const size_t first = (begin + half) >> rate;
+        const size_t last = (end + half) >> rate;
+        if (first == last)
+            continue;
+
+        renderSteady(partition.steadyVoices[rate], partition.rateBuses[rate], first, last, 1 << rate);
+        renderGliding(partition.glidingVoices[rate], partition.rateBuses[rate], first, last, 1 << rate);
+    }
+
+    for (size_t k = 0; k < partition.tableVoices.size(); ++k)
+        renderVoice(partition.tableVoices[k], partition.rateBuses[0], begin, end);
+}
+
+void OscillatorBank::renderPartition(Partition& partition)
+{
+    for (int rate = 1; rate <= MULTIRATE_STAGES && mDelaying; ++rate)
+        for (int bus = 0; bus < mLayout.getBusesCount(); ++bus)
+            std::fill(partition.rateBuses[rate][bus], partition.rateBuses[rate][bus] + (mBlockFrames >> rate), 0.0f);
+
+    size_t begin = 0;
+    for (int split = 0; split <= mSplitsCount; ++split)
+    {
+        size_t end = (split < mSplitsCount) ? mSplits[split] : mBlockFrames;
+        renderSegment(partition, begin, end);
+
+        if (split < mSplitsCount)
+        {
+            for (size_t k = partition.first; k < partition.last; ++k)
+            {
+                int voice = mActiveVoices[k];
+                int64_t pending = mPendingFrame[voice];
+                if (pending != NO_PENDING && !mScalarVoice[voice] && (size_t)std::max<int64_t>(pending - mFrame, 0) == end)
+                    applyPending(voice);
+            }
+        }
+        begin = end;
+    }
+}
+
+void OscillatorBank::renderPartitionJob(void* bank, int index)
+{
+    OscillatorBank* self = static_cast<OscillatorBank*>(bank);
+    Partition& partition = self->mPartitions[index];
+
+    if (index > 0)
+        for (int bus = 0; bus < self->mLayout.getBusesCount(); ++bus)
+            std::fill(partition.buffer[bus].begin(), partition.buffer[bus].begin() + self->mBlockFrames, 0.0f);
+    self->renderPartition(partition);
+}
+
+void OscillatorBank::render(float* left, float* right, size_t frames)
+{
+    float* channels[2] = {left, right};
+    render(channels, frames);
+}
+
+void OscillatorBank::render(float* const* channels, size_t frames)
+{
+    // idle workers spin for a quarter of a block, which only bridges to the next one when rendering fills most of
+    // the block
+    mWorkers.setSpinTime(0.25 * frames / mSampleRate);
+
+    float* buses[SpeakerLayout::MAX_BUSES];
+
+    if (!mLayout.isEncoded())
+    {
+        for (int bus = 0; bus < mLayout.getBusesCount(); ++bus)
+            buses[bus] = channels[mLayout.getBusChannel(bus)];
+        renderBuses(buses, frames);
+        return;
+    }
+
+    for (size_t done = 0; done < frames; done += ENCODE_MAX_FRAMES)
+    {
+        const size_t count = std::min(frames - done, ENCODE_MAX_FRAMES);
+        float* outputs[SpeakerLayout::MAX_CHANNELS];
+        for (int channel = 0; channel < mLayout.getChannelsCount(); ++channel)
+            outputs[channel] = channels[channel] + done;
+        for (int bus = 0; bus < mLayout.getBusesCount(); ++bus)
+        {
+            buses[bus] = &mEncodeBuffer[bus][0];
+            std::fill(buses[bus], buses[bus] + count, 0.0f);
+        }
+
+        renderBuses(buses, count);
+        mLayout.encode(buses, outputs, count);
+    }
+}
+
+void OscillatorBank::renderBuses(float* const* buses, size_t frames)
+{
+    const int busesCount = mLayout.getBusesCount();
+
+    if (frames > MULTIRATE_MAX_FRAMES)
+    {
+        float* rest[SpeakerLayout::MAX_BUSES];
+        for (int bus = 0; bus < busesCount; ++bus)
+            rest[bus] = buses[bus] + MULTIRATE_MAX_FRAMES;
+        OscillatorBank::renderBuses(buses, MULTIRATE_MAX_FRAMES);
+        OscillatorBank::renderBuses(rest, frames - MULTIRATE_MAX_FRAMES);
+        return;
+    }
+
+    // only the decimated rates need whole blocks
+    if (mCarryFrames > 0 || (frames % MULTIRATE_ALIGN_FRAMES != 0 && (mMultirateEnabled || mDelayed || mDelayFade > 0)))
+    {
+        renderAligned(buses, frames);
+        return;
+    }
+
+    const int64_t blockEnd = mFrame + (int64_t)frames;
+
+    sortVoicesByBus();
+    updatePruning();
+    updateDelay();
+
+    // the block is split wherever pending changes start; a voice whose change falls beyond
+    // the last split the block can afford is rendered on its own instead
+    mSplitsCount = 0;
+    mBlockFrames = frames;
+    mScalarVoices.clear();
+
+    for (size_t k = 0; k < mActiveVoices.size(); ++k)
+    {
+        int voice = mActiveVoices[k];
+        int64_t pending = mPendingFrame[voice];
+        if (pending == NO_PENDING || pending >= blockEnd)
+            continue;
+
+        size_t offset = (size_t)std::max<int64_t>(pending - mFrame, 0);
+        size_t* found = std::find(mSplits, mSplits + mSplitsCount, offset);
+        if (found != mSplits + mSplitsCount)
+            continue;
+
+        if (mSplitsCount < MAX_SPLITS)
+        {
+            size_t* position = std::upper_bound(mSplits, mSplits + mSplitsCount, offset);
+            std::copy_backward(position, mSplits + mSplitsCount, mSplits + mSplitsCount + 1);
+            *position = offset;
+            ++mSplitsCount;
+        }
+        else
+        {
+            mScalarVoice[voice] = 1;
+            mScalarVoices.push_back(voice);
+        }
+    }
+
+    updateRates(blockEnd);
+
+    // full rate voices go into a delay line, read delayed to meet the upsampled ones or straight away
+    float* mix[SpeakerLayout::MAX_BUSES];
+    for (int bus = 0; bus < busesCount; ++bus)
+    {
+        mix[bus] = &mRateInput[0][bus][getRateHistory(0)];
+        std::fill(mix[bus], mix[bus] + frames, 0.0f);
+    }
+
+    // the first partition renders straight into the mix, the others into their own buffers
+    const size_t activeCount = mActiveVoices.size();
+    const bool parallel = (mPartitions.size() > 1 && frames <= PARALLEL_MAX_FRAMES && frames * activeCount >= PARALLEL_MIN_VOICE_FRAMES);
+    const size_t partitionsCount = parallel ? mPartitions.size() : 1;
+
+    for (size_t p = 0; p < partitionsCount; ++p)
+    {
+        Partition& partition = mPartitions[p];
+        partition.first = activeCount * p / partitionsCount;
+        partition.last = activeCount * (p + 1) / partitionsCount;
+        for (int bus = 0; bus < busesCount; ++bus)
+        {
+            partition.rateBuses[0][bus] = (p == 0) ? mix[bus] : &partition.buffer[bus][0];
+            for (int rate = 1; rate <= MULTIRATE_STAGES; ++rate)
+                partition.rateBuses[rate][bus] = (p == 0) ? &mRateInput[rate][bus][getRateHistory(rate)] : &partition.rateBuffer[rate][bus][0];
+        }
+    }
+
+    if (parallel)
+    {
+        mWorkers.run(&OscillatorBank::renderPartitionJob, this);
+        for (size_t p = 1; p < partitionsCount; ++p)
+        {
+            for (int bus = 0; bus < busesCount; ++bus)
+            {
+                const float* rendered = mPartitions[p].rateBuses[0][bus];
+                for (size_t k = 0; k < frames; ++k)
+                    mix[bus][k] += rendered[k];
+            }
+        }
+    }
+    else
+    {
+        renderPartition(mPartitions[0]);
+    }
+
+    for (size_t k = 0; k < mScalarVoices.size(); ++k)
+    {
+        int voice = mScalarVoices[k];
+        size_t offset = (size_t)std::max<int64_t>(mPendingFrame[voice] - mFrame, 0);
+        renderVoice(voice, mix, 0, offset);
+        applyPending(voice);
+        renderVoice(voice, mix, offset, frames);
+        mScalarVoice[voice] = 0;
+    }
+
+    renderGhosts(mix);
+    mixMultirate(buses, partitionsCount);
+
+    recycleVoices();
+    skipTransposition(frames);
+    mFrame = blockEnd;
+}
@@ -0,0 +1,381 @@
+//
+//  OscillatorBank.h
+//  CASynthesis
+//
+//
+
+#ifndef OscillatorBank_h
+#define OscillatorBank_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "FastSine.h"
+#include "Psychoacoustics.h"
+#include "WorkerPool.h"
+#include "SpeakerLayout.h"
+#include "Wavetable.h"
+
+// A change to one cell's voice, starting on an absolute sample frame
+struct VoiceEvent
+{
+    enum Type
+    {
+        FREQ,
+        GAIN,
+        // 0 to 1, see SpeakerLayout::getPanGains()
+        PAN,
+        // ratio applied to every cell's frequency, glided over rampFrames; the cell is ignored
+        TRANSPOSE,
+        // index of the wavetable the cell plays, 0 for a sine; see OscillatorBank::setWavetable()
+        WAVE
+    };
+
+    int cell;
+    Type type;
+    float value;
+    uint32_t rampFrames;
+    int64_t frame;
+};
+
+// Additive bank of voices that cells borrow from a fixed pool, each with its own glide, gain ramp, pan and wave,
+// rendered into the buses of a SpeakerLayout. Not thread safe: events are applied on the rendering thread.
+class OscillatorBank
+{
+public:
+    enum GlideShape
+    {
+        GLIDE_LINEAR,
+        GLIDE_EXPONENTIAL
+    };
+
+    //! how a ramp or glide moves from its start to its target, applied on top of the glide shape
+    enum RampShape
+    {
+        RAMP_LINEAR,
+        RAMP_SMOOTH
+    };
+
+protected:
+    static const int64_t NO_PENDING = -1;
+    static const int LANES = 8;
+    static const int MAX_SPLITS = 16;
+    static const int MAX_CONTROL_FRAMES = 64;
+    static const size_t MIN_CONTROL_SAMPLES = 4;
+    static const int MULTIRATE_STAGES = 3;
+    static const int HALFBAND_TAPS = 8;
+    static const int MULTIRATE_HISTORY = 2 * HALFBAND_TAPS - 1;
+    static const uint32_t MULTIRATE_FADE_FRAMES = 256;
+    static const size_t MULTIRATE_ALIGN_FRAMES = 1 << MULTIRATE_STAGES;
+    static const uint32_t PRUNE_FADE_FRAMES = MAX_CONTROL_FRAMES;
+    static const uint8_t NO_RATE = 0xff;
+    static const int THRESHOLD_STEPS_PER_OCTAVE = 24;
+    static const int THRESHOLD_OCTAVES = 10;
+
+    // one thread's share of a block: a run of active voices and where its output goes
+    struct Partition
+    {
+        size_t first;
+        size_t last;
+        std::vector<int> steadyVoices[MULTIRATE_STAGES + 1];
+        std::vector<int> glidingVoices[MULTIRATE_STAGES + 1];
+        std::vector<int> tableVoices;
+        std::vector<float> buffer[SpeakerLayout::MAX_BUSES];
+
+        // output by rate and bus, the first partition's goes straight to the bank's
+        std::vector<float> rateBuffer[MULTIRATE_STAGES + 1][SpeakerLayout::MAX_BUSES];
+        float* rateBuses[MULTIRATE_STAGES + 1][SpeakerLayout::MAX_BUSES];
+    };
+
+    double mSampleRate;
+    int64_t mFrame;
+    SpeakerLayout mLayout;
+    int mGridWidth;
+    GlideShape mGlideShape;
+    fastsine::Accuracy mSineAccuracy;
+    RampShape mRampShape;
+    size_t mControlFrames;
+
+    bool mPruningEnabled;
+    float mFullScaleSPL;
+    int mPrunedCount;
+    std::vector<uint8_t> mPruned;
+    std::vector<uint8_t> mWasPruned;
+    // frames left of the fade out of, or back from, pruning
+    std::vector<uint32_t> mPruneFade;
+    std::vector<uint8_t> mVoiceBand;
+    std::vector<float> mVoicePower;
+
+    // threshold in quiet as power relative to full scale, and critical band, on a log frequency grid from 20 Hz
+    std::vector<float> mQuietPower;
+    std::vector<uint8_t> mQuietBand;
+    std::vector<float> mMaskingSpread;
+    std::vector<float> mBandQuietPower;
+
+    bool mMultirateEnabled;
+    // whether the output is the delayed one, and frames left of its crossfade with the direct one; the delay lines
+    // run while either holds, and voices decimate only once the crossfade to the delayed output is over
+    bool mDelayed;
+    uint32_t mDelayFade;
+    bool mDelaying;
+    bool mDecimating;
+    int mDecimatedCount;
+    std::vector<uint8_t> mVoiceRate;
+    std::vector<uint8_t> mVoiceLastRate;
+
+    // a voice changing rate fades in at the new one while a steady copy of it fades out at the old one; a stolen
+    // voice leaves such a copy at its last rate, and a voice changing table one playing the old table
+    struct Ghost
+    {
+        int rate;
+        int wave;
+        float freq;
+        float phase;
+        float gain;
+        int bus;
+        float panFirst;
+        float panSecond;
+        uint32_t fadeFrames;
+    };
+    std::vector<uint32_t> mRateFade;
+    std::vector<Ghost> mGhosts;
+
+    // odd taps of the half band filter; per rate and bus, that rate's voices with their delay line in front,
+    // and the sum handed up to the next rate with the filter's history in front
+    float mHalfband[HALFBAND_TAPS];
+    std::vector<float> mRateInput[MULTIRATE_STAGES + 1][SpeakerLayout::MAX_BUSES];
+    std::vector<float> mRateMix[MULTIRATE_STAGES][SpeakerLayout::MAX_BUSES];
+    // the delayed output while it crossfades with the direct one
+    std::vector<float> mFadeMix[SpeakerLayout::MAX_BUSES];
+
+    // what is left of the block of MULTIRATE_ALIGN_FRAMES the last call rendered ahead
+    std::vector<float> mCarry[SpeakerLayout::MAX_BUSES];
+    size_t mCarryFrames;
+
+    // buses of an encoded layout, rendered in pieces of ENCODE_MAX_FRAMES
+    std::vector<float> mEncodeBuffer[SpeakerLayout::MAX_BUSES];
+
+    std::vector<float> mFreq;
+    std::vector<float> mFreqTarget;
+    std::vector<float> mFreqStart;
+    std::vector<uint32_t> mFreqRampFrames;
+    std::vector<uint32_t> mFreqRampLength;
+    std::vector<uint8_t> mFreqRampShape;
+    std::vector<uint8_t> mFreqExponential;
+    std::vector<float> mPhase;
+
+    float mTransposition;
+    float mTranspositionStart;
+    float mTranspositionTarget;
+    uint32_t mTranspositionFrames;
+    uint32_t mTranspositionLength;
+
+    std::vector<float> mGain;
+    std::vector<float> mGainTarget;
+    std::vector<float> mGainStart;
+    std::vector<uint32_t> mRampFrames;
+    std::vector<uint32_t> mRampLength;
+    std::vector<uint8_t> mGainRampShape;
+    std::vector<int> mVoiceBus;
+    std::vector<float> mPanFirst;
+    std::vector<float> mPanSecond;
+    std::vector<uint8_t> mVoiceWave;
+    std::vector<uint32_t> mWaveFade;
+
+    // what a cell sounds like while it has no voice, and which voice it has
+    std::vector<float> mCellFreq;
+    std::vector<int> mCellBus;
+    std::vector<float> mCellPanFirst;
+    std::vector<float> mCellPanSecond;
+    std::vector<uint8_t> mCellWave;
+    std::vector<int> mCellVoice;
+
+    std::vector<int> mVoiceCell;
+    std::vector<int> mFreeVoices;
+    std::vector<int> mActiveVoices;
+    std::vector<int> mActivePosition;
+
+    // at most one pending change per voice, the newest one wins
+    std::vector<int64_t> mPendingFrame;
+    std::vector<float> mPendingFreq;
+    std::vector<uint32_t> mPendingFreqRampFrames;
+    std::vector<float> mPendingGain;
+    std::vector<uint32_t> mPendingRampFrames;
+
+    // per block state shared by the render threads
+    std::vector<uint8_t> mScalarVoice;
+    std::vector<int> mScalarVoices;
+    size_t mSplits[MAX_SPLITS];
+    int mSplitsCount;
+    size_t mBlockFrames;
+
+    WorkerPool mWorkers;
+    std::vector<Partition> mPartitions;
+
+    // slot 0 is the sine and stays empty
+    std::vector<Wavetable> mWavetables;
+
+    int allocateVoice(int cell, float gain);
+    void releaseVoice(int voice);
+    //! frees a voice that may still be sounding for a new cell
+    virtual void releaseStolenVoice(int voice);
+    //! switches a voice to table \a wave, crossfading it if it is sounding
+    virtual void changeVoiceWave(int voice, int wave);
+    void recycleVoices();
+
+    void updateCellPans();
+    void setCellPan(int cell, const SpeakerGains& gains);
+    void sortVoicesByBus();
+
+    void updateThresholds();
+    void updatePruning();
+    void decidePruning();
+    //! pruned and faded out, so it renders nothing
+    bool isPrunedOut(int voice) const;
+    float getPruneFade(int voice) const;
+
+    static float shapeRamp(float progress, uint8_t shape);
+
+    void resetMultirate();
+    void updateDelay();
+    void updateRates(int64_t blockEnd);
+    float getRateFade(int voice) const;
+    void skipRateFade(int voice, size_t frames);
+    //! the product of the voice's rate, pruning and table fades
+    float getVoiceFade(int voice) const;
+    void skipVoiceFades(int voice, size_t frames);
+    //! leaves a steady copy of the voice as it is now, fading out at \a rate
+    void pushGhost(int voice, int rate);
+    void renderGhosts(float* const* buses);
+    void mixMultirate(float* const* buses, size_t partitionsCount);
+    //! renders \a frames that need not be a multiple of MULTIRATE_ALIGN_FRAMES through the carry
+    void renderAligned(float* const* buses, size_t frames);
+
+    void applyPending(int voice);
+    void rampGain(int voice, float gain, uint32_t rampFrames);
+    void glideFreq(int voice, float freq, uint32_t rampFrames);
+    void skipFreqGlide(int voice, size_t frames);
+    void skipGainRamp(int voice, size_t frames);
+    //! moves a voice that renders nothing from \a begin to \a end of the block, phase included
+    void skipVoice(int voice, size_t begin, size_t end);
+    void renderVoice(int voice, float* const* buses, size_t begin, size_t end);
+    //! the table a voice plays, NULL for a sine
+    const Wavetable* getVoiceTable(int voice) const;
+
+    //! the ratio \a frames after the bank's frame, without moving the glide
+    float getTranspositionAt(size_t frames) const;
+    //! the highest the ratio gets before its glide ends
+    float getTranspositionPeak() const;
+    void skipTransposition(size_t frames);
+
+    int getLaneGroup(const std::vector<int>& voices, int group) const;
+    void loadPanLanes(const int* voices, int count, float* panFirst, float* panSecond) const;
+    void advanceGainLanes(const int* voices, int count, size_t frames, size_t samples, float* gain, float* step);
+    void reservePartitions();
+    void renderPartition(Partition& partition);
+    void renderSegment(Partition& partition, size_t begin, size_t end);
+    void renderSteady(const std::vector<int>& voices, float* const* buses, size_t begin, size_t end, int decimation);
+    void renderGliding(const std::vector<int>& voices, float* const* buses, size_t begin, size_t end, int decimation);
+    template <int Terms>
+    void renderGliding(const std::vector<int>& voices, float* const* buses, size_t begin, size_t end, int decimation);
+
+    static void renderPartitionJob(void* bank, int index);
+    static size_t getRateHistory(int rate);
+    static void upsample(const float* input, size_t count, const float* taps, float* output);
+
+    //! adds \a frames frames to every bus of the layout and advances the bank's frame
+    virtual void renderBuses(float* const* buses, size_t frames);
+    //! called once the layout has changed, after the bank has resized its own buffers
+    virtual void updateLayout() {}
+
+public:
+    //! \a voicesCount of 0 gives every cell its own voice
+    OscillatorBank(int cellsCount = 0, int voicesCount = 0, double sampleRate = 44100.0);
+    virtual ~OscillatorBank() {}
+
+    void resize(int cellsCount, int voicesCount = 0);
+    int getCellsCount() const;
+    int getVoicesCount() const;
+    int getActiveVoicesCount() const;
+
+    double getSampleRate() const;
+    void setSampleRate(double sampleRate);
+
+    GlideShape getGlideShape() const;
+    void setGlideShape(GlideShape shape);
+
+    fastsine::Accuracy getSineAccuracy() const;
+    void setSineAccuracy(fastsine::Accuracy accuracy);
+
+    //! shape given to ramps and glides started from now on
+    RampShape getRampShape() const;
+    void setRampShape(RampShape shape);
+
+    //! ramps and glides are evaluated every this many frames, 1 to 64, and interpolated linearly in between;
+    //! decimated voices keep at least MIN_CONTROL_SAMPLES of their own samples between control points
+    size_t getControlFrames() const;
+    void setControlFrames(size_t frames);
+
+    bool isPruningEnabled() const;
+    void setPruningEnabled(bool enabled);
+    float getFullScaleSPL() const;
+    void setFullScaleSPL(float spl);
+    //! voices left out of the last block
+    int getPrunedCount() const;
+
+    //! renders voices far below Nyquist at decimated rates, which delays all output by getMultirateLatency() frames;
+    //! a change crossfades over a few hundred frames, except before the first block
+    bool isMultirateEnabled() const;
+    void setMultirateEnabled(bool enabled);
+    size_t getMultirateLatency() const;
+    //! frames from an event's frame to its sound in the output
+    virtual size_t getLatency() const;
+    //! voices rendered below the full rate in the last block
+    int getDecimatedCount() const;
+
+    //! longer blocks are rendered in pieces
+    static const size_t MULTIRATE_MAX_FRAMES = 4096;
+
+    //! blocks of fewer voice frames, or more frames than a partition buffer holds, render on the calling thread
+    static const size_t PARALLEL_MIN_VOICE_FRAMES = 128 * 256;
+    static const size_t PARALLEL_MAX_FRAMES = 4096;
+
+    //! multiplies every frequency by \a ratio, gliding there exponentially over \a glideFrames
+    void setTransposition(float ratio, uint32_t glideFrames = 0);
+    float getTransposition() const;
+
+    static const int MAX_WAVETABLES = 8;
+
+    //! puts \a table in slot \a index, 1 to MAX_WAVETABLES - 1, for WAVE events to select; cells on an empty slot
+    //! play sines. Copies the table, so not from the audio thread.
+    void setWavetable(int index, const Wavetable& table);
+    //! exchanges slot \a index with \a table, which gets the slot's old table back; allocates nothing
+    void swapWavetable(int index, Wavetable& table);
+    const Wavetable& getWavetable(int index) const;
+
+    //! pans every cell to its place on the grid, laid out as CAKernel::getIndex() has it with \a gridWidth cells
+    //! to a column, 0 for a square grid; PAN events override it. Resizes buffers, so not from the audio thread.
+    void setLayout(const SpeakerLayout& layout, int gridWidth = 0);
+    const SpeakerLayout& getLayout() const;
+    int getChannelsCount() const;
+
+    //! longer blocks of an encoded layout are rendered in pieces
+    static const size_t ENCODE_MAX_FRAMES = 4096;
+
+    //! total render threads including the audio thread; starts or stops workers, so not from the audio thread
+    void setThreadCount(int threadCount);
+    int getThreadCount() const;
+
+    int64_t getFrame() const;
+    void setFrame(int64_t frame);
+
+    void apply(const VoiceEvent& event);
+
+    //! adds \a frames frames of output to each of the layout's getChannelsCount() channels and advances the bank's frame
+    void render(float* const* channels, size_t frames);
+    //! the same for stereo layouts
+    void render(float* left, float* right, size_t frames);
+};
+
+#endif /* OscillatorBank_h */
@@ -0,0 +1,318 @@
+//
+//  OscillatorBankNode.cpp
+//  CASynthesis
+//
+//
+
+#include "OscillatorBankNode.h"
+#include "RealtimeGuard.h"
+
+#include "cinder/audio/Context.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace ci;
+
+const int OscillatorBankNode::EVENTS_CAPACITY;
+
+OscillatorBankNode::OscillatorBankNode(int cellsCount, int voicesCount, Engine engine, SpeakerLayout::Type layout, const Format& format)
+: InputNode(format), mEngine(engine), mPendingHead(0), mNextFrame(-1)
+{
+    if (engine == ENGINE_SPECTRAL)
+        mBank.reset(new SpectralSynth(cellsCount, voicesCount));
+    else
+        mBank.reset(new OscillatorBank(cellsCount, voicesCount));
+    mBank->setLayout(SpeakerLayout(layout));
+
+    // the bank writes every channel of its layout, whatever the format asked for
+    setChannelMode(ChannelMode::SPECIFIED);
+    setNumChannels(mBank->getChannelsCount());
+
+    mEvents.reset(EVENTS_CAPACITY);
+    // TRANSPOSE takes the row of cell -1
+    mPendingIndex.assign((size_t)(cellsCount + 1) * (VoiceEvent::WAVE + 1), -1);
+
+    mGlideShape = mBank->getGlideShape();
+    mSineAccuracy = mBank->getSineAccuracy();
+    mRampShape = mBank->getRampShape();
+    mControlFrames = mBank->getControlFrames();
+    mPruningEnabled = mBank->isPruningEnabled();
+    mMultirateEnabled = mBank->isMultirateEnabled();
+    mLatency = mBank->getLatency();
+    mLoudnessEnabled = true;
+}
+
+void OscillatorBankNode::initialize()
+{
+    mBank->setSampleRate(getSampleRate());
+    mLoudness.setSampleRate(getSampleRate());
+}
+
+int OscillatorBankNode::getCellsCount() const
+{
+    return mBank->getCellsCount();
+}
+
+int OscillatorBankNode::getVoicesCount() const
+{
+    return mBank->getVoicesCount();
+}
+
+OscillatorBankNode::Engine OscillatorBankNode::getEngine() const
+{
+    return mEngine;
+}
+
+const SpeakerLayout& OscillatorBankNode::getLayout() const
+{
+    return mBank->getLayout();
+}
+
+void OscillatorBankNode::push(int cell, VoiceEvent::Type type, float value, double rampSeconds, double time)
+{
+    double sampleRate = getSampleRate();
+
+    VoiceEvent event;
+    event.cell = cell;
+    event.type = type;
+    event.value = value;
+    event.rampFrames = (uint32_t)(rampSeconds * sampleRate + 0.5);
+    event.frame = (time >= 0.0) ? (int64_t)(time * sampleRate + 0.5) : 0;
+
+    // anything already waiting goes first, so the ring keeps the order the changes were made in
+    flush();
+    int& index = getPendingIndex(event);
+    if (index >= 0)
+    {
+        mPending[index] = event;
+        mStats.addDroppedEvent();
+        return;
+    }
+    if (mPendingHead == mPending.size() && mEvents.push(event))
+        return;
+
+    index = (int)mPending.size();
+    mPending.push_back(event);
+}
+
+int& OscillatorBankNode::getPendingIndex(const VoiceEvent& event)
+{
+    return mPendingIndex[(size_t)(event.cell + 1) * (VoiceEvent::WAVE + 1) + event.type];
+}
+
+void OscillatorBankNode::flush()
+{
+    for (; mPendingHead < mPending.size(); ++mPendingHead)
+    {
+        const VoiceEvent& event = mPending[mPendingHead];
+        if (!mEvents.push(event))
+            return;
+        getPendingIndex(event) = -1;
+    }
+    mPending.clear();
+    mPendingHead = 0;
+}
+
+size_t OscillatorBankNode::getPendingEventsCount() const
+{
+    return mPending.size() - mPendingHead;
+}
+
+void OscillatorBankNode::setFreq(int cell, float freq, double glideSeconds, double time)
+{
+    push(cell, VoiceEvent::FREQ, freq, glideSeconds, time);
+}
+
+void OscillatorBankNode::rampGain(int cell, float gain, double rampSeconds, double time)
+{
+    push(cell, VoiceEvent::GAIN, gain, rampSeconds, time);
+}
+
+void OscillatorBankNode::setPan(int cell, float pan)
+{
+    push(cell, VoiceEvent::PAN, pan, 0.0, -1.0);
+}
+
+void OscillatorBankNode::setTransposition(float ratio, double glideSeconds)
+{
+    push(-1, VoiceEvent::TRANSPOSE, ratio, glideSeconds, -1.0);
+}
+
+void OscillatorBankNode::setWave(int cell, int index)
+{
+    push(cell, VoiceEvent::WAVE, (float)index, 0.0, -1.0);
+}
+
+void OscillatorBankNode::setWavetable(int index, const Wavetable& table)
+{
+    // the copy is made before taking the lock and the slot's old table is freed after releasing it
+    Wavetable copy(table);
+    std::lock_guard<std::mutex> lock(getContext()->getMutex());
+    mBank->swapWavetable(index, copy);
+}
+
+OscillatorBank::GlideShape OscillatorBankNode::getGlideShape() const
+{
+    return (OscillatorBank::GlideShape)mGlideShape.load();
+}
+
+void OscillatorBankNode::setGlideShape(OscillatorBank::GlideShape shape)
+{
+    mGlideShape = shape;
+}
+
+fastsine::Accuracy OscillatorBankNode::getSineAccuracy() const
+{
+    return (fastsine::Accuracy)mSineAccuracy.load();
+}
+
+void OscillatorBankNode::setSineAccuracy(fastsine::Accuracy accuracy)
+{
+    mSineAccuracy = accuracy;
+}
+
+OscillatorBank::RampShape OscillatorBankNode::getRampShape() const
+{
+    return (OscillatorBank::RampShape)mRampShape.load();
+}
+
+void OscillatorBankNode::setRampShape(OscillatorBank::RampShape shape)
+{
+    mRampShape = shape;
+}
+
+size_t OscillatorBankNode::getControlFrames() const
+{
+    return mControlFrames;
+}
+
+void OscillatorBankNode::setControlFrames(size_t frames)
+{
+    mControlFrames = frames;
+}
+
+void OscillatorBankNode::setThreadCount(int threadCount)
+{
+    std::lock_guard<std::mutex> lock(getContext()->getMutex());
+    mBank->setThreadCount(threadCount);
+}
+
+int OscillatorBankNode::getThreadCount() const
+{
+    return mBank->getThreadCount();
+}
+
+bool OscillatorBankNode::isPruningEnabled() const
+{
+    return mPruningEnabled;
+}
+
+void OscillatorBankNode::setPruningEnabled(bool enabled)
+{
+    mPruningEnabled = enabled;
+}
+
+bool OscillatorBankNode::isMultirateEnabled() const
+{
+    return mMultirateEnabled;
+}
+
+void OscillatorBankNode::setMultirateEnabled(bool enabled)
+{
+    mMultirateEnabled = enabled;
+}
+
+bool OscillatorBankNode::isLoudnessEnabled() const
+{
+    return mLoudnessEnabled;
+}
+
+void OscillatorBankNode::setLoudnessEnabled(bool enabled)
+{
+    mLoudnessEnabled = enabled;
+}
+
+void OscillatorBankNode::setVoicePower(double gainSquaredSum)
+{
+    mLoudness.setVoicePower(gainSquaredSum);
+}
+
+const LoudnessControl& OscillatorBankNode::getLoudness() const
+{
+    return mLoudness;
+}
+
+uint32_t OscillatorBankNode::getDroppedEventsCount() const
+{
+    return mStats.getDroppedEventsCount();
+}
+
+int OscillatorBankNode::getActiveVoicesCount() const
+{
+    return mStats.getActiveVoicesCount();
+}
+
+int OscillatorBankNode::getPrunedVoicesCount() const
+{
+    return mStats.getPrunedVoicesCount();
+}
+
+int OscillatorBankNode::getDecimatedVoicesCount() const
+{
+    return mStats.getDecimatedVoicesCount();
+}
+
+size_t OscillatorBankNode::getLatency() const
+{
+    return mLatency;
+}
+
+RenderStats& OscillatorBankNode::getRenderStats()
+{
+    return mStats;
+}
+
+void OscillatorBankNode::process(audio::Buffer* buffer)
+{
+    RealtimeGuard::Scope realtime;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    mBank->setGlideShape((OscillatorBank::GlideShape)mGlideShape.load());
+    mBank->setSineAccuracy((fastsine::Accuracy)mSineAccuracy.load());
+    mBank->setRampShape((OscillatorBank::RampShape)mRampShape.load());
+    mBank->setControlFrames(mControlFrames);
+    mBank->setPruningEnabled(mPruningEnabled);
+    mBank->setMultirateEnabled(mMultirateEnabled);
+    mLatency = mBank->getLatency();
+
+    // the bank follows the context's clock, so event frames line up with getNumProcessedSeconds(); it may run a
+    // few frames ahead of it with multirate on, so it is only moved when the context's clock jumps
+    const int64_t frame = (int64_t)getContext()->getNumProcessedFrames();
+    if (frame != mNextFrame)
+        mBank->setFrame(frame);
+    mNextFrame = frame + (int64_t)buffer->getNumFrames();
+
+    // whatever the UI thread queues while this drains simply goes out with the next block
+    VoiceEvent event;
+    int queueDepth = 0;
+    while (mEvents.pop(event))
+    {
+        mBank->apply(event);
+        ++queueDepth;
+    }
+
+    float* channels[SpeakerLayout::MAX_CHANNELS];
+    for (int channel = 0; channel < mBank->getChannelsCount(); ++channel)
+        channels[channel] = buffer->getChannel(channel);
+
+    buffer->zero();
+    mBank->render(channels, buffer->getNumFrames());
+    if (mLoudnessEnabled)
+        mLoudness.process(channels, mBank->getChannelsCount(), buffer->getNumFrames());
+
+    const double renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    mStats.addBlock(renderSeconds, buffer->getNumFrames() / getSampleRate());
+    mStats.setVoices(mBank->getActiveVoicesCount(), mBank->getPrunedCount(), mBank->getDecimatedCount());
+    mStats.setQueueDepth(queueDepth);
+}
@@ -0,0 +1,148 @@
+//
+//  OscillatorBankNode.h
+//  CASynthesis
+//
+//
+
+#ifndef OscillatorBankNode_h
+#define OscillatorBankNode_h
+
+#include "cinder/audio/Node.h"
+#include "cinder/audio/InputNode.h"
+
+#include "OscillatorBank.h"
+#include "SpectralSynth.h"
+#include "SpscRing.h"
+#include "RenderStats.h"
+#include "LoudnessControl.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+typedef std::shared_ptr<class OscillatorBankNode> OscillatorBankNodeRef;
+
+// Renders every cell through one pooled voice bank in a single stereo node. Voice changes made on the UI thread go
+// through a fixed size wait free ring and are handed to the bank at the start of the next block; only one thread
+// may queue changes. When the ring is full a change waits on that thread in a per cell slot, where a newer change
+// of the same kind replaces it, until flush() finds room; queueing never blocks. Times are absolute context
+// seconds, negative means "as soon as possible". The engine and speaker layout are fixed per node: per sample oscillators,
+// or inverse FFT synthesis for grids too large for them, and one output channel per channel of the layout.
+// The bank's mix goes through a LoudnessControl, which the UI thread feeds with the voices' summed power.
+class OscillatorBankNode : public ci::audio::InputNode
+{
+public:
+    enum Engine
+    {
+        ENGINE_OSCILLATORS,
+        ENGINE_SPECTRAL
+    };
+
+protected:
+    Engine mEngine;
+    std::unique_ptr<OscillatorBank> mBank;
+
+    SpscRing<VoiceEvent> mEvents;
+    // changes waiting for room in the ring, oldest first from mPendingHead, and each one's index by cell and type
+    std::vector<VoiceEvent> mPending;
+    size_t mPendingHead;
+    std::vector<int> mPendingIndex;
+    RenderStats mStats;
+    std::atomic<int> mGlideShape;
+    std::atomic<int> mSineAccuracy;
+    std::atomic<int> mRampShape;
+    std::atomic<size_t> mControlFrames;
+    std::atomic<bool> mPruningEnabled;
+    std::atomic<bool> mMultirateEnabled;
+    std::atomic<size_t> mLatency;
+    // context frame the next block should start on, for telling a jump of its clock from the bank's carried frames
+    int64_t mNextFrame;
+    LoudnessControl mLoudness;
+    std::atomic<bool> mLoudnessEnabled;
+
+    void initialize() override;
+    void process(ci::audio::Buffer* buffer) override;
+
+    void push(int cell, VoiceEvent::Type type, float value, double rampSeconds, double time);
+    int& getPendingIndex(const VoiceEvent& event);
+
+public:
+    //! ring slots, whatever the number of cells
+    static const int EVENTS_CAPACITY = 16384;
+
+    //! \a voicesCount is the size of the voice pool, 0 gives every cell its own voice; cells pan to their place on
+    //! a square grid, see OscillatorBank::setLayout()
+    OscillatorBankNode(int cellsCount, int voicesCount = 0, Engine engine = ENGINE_OSCILLATORS,
+                       SpeakerLayout::Type layout = SpeakerLayout::LAYOUT_STEREO, const Format& format = Format());
+
+    int getCellsCount() const;
+    int getVoicesCount() const;
+    Engine getEngine() const;
+    const SpeakerLayout& getLayout() const;
+
+    //! glides phase continuously to \a freq over \a glideSeconds
+    void setFreq(int cell, float freq, double glideSeconds = 0.0, double time = -1.0);
+    void rampGain(int cell, float gain, double rampSeconds, double time = -1.0);
+    //! moves a cell away from its place on the grid, 0 to 1 as SpeakerLayout::getPanGains() has it
+    void setPan(int cell, float pan);
+    //! scales every cell's frequency by \a ratio, gliding exponentially over \a glideSeconds
+    void setTransposition(float ratio, double glideSeconds = 0.0);
+    //! plays the wavetable in slot \a index, 0 for a sine, crossfading a sounding cell; the spectral engine plays
+    //! sines regardless
+    void setWave(int cell, int index);
+
+    //! fills slot \a index, 1 to OscillatorBank::MAX_WAVETABLES - 1; copies the table, then swaps it in under the
+    //! context's lock
+    void setWavetable(int index, const Wavetable& table);
+
+    OscillatorBank::GlideShape getGlideShape() const;
+    void setGlideShape(OscillatorBank::GlideShape shape);
+
+    fastsine::Accuracy getSineAccuracy() const;
+    void setSineAccuracy(fastsine::Accuracy accuracy);
+
+    OscillatorBank::RampShape getRampShape() const;
+    void setRampShape(OscillatorBank::RampShape shape);
+
+    //! frames between control points of ramps and glides
+    size_t getControlFrames() const;
+    void setControlFrames(size_t frames);
+
+    //! render threads including the audio thread; only the oscillator engine uses more than one
+    void setThreadCount(int threadCount);
+    int getThreadCount() const;
+
+    bool isPruningEnabled() const;
+    void setPruningEnabled(bool enabled);
+
+    //! low voices at decimated rates; costs OscillatorBank::getMultirateLatency() frames of latency while on
+    bool isMultirateEnabled() const;
+    void setMultirateEnabled(bool enabled);
+
+    //! makeup gain and limiter on the mix, on by default
+    bool isLoudnessEnabled() const;
+    void setLoudnessEnabled(bool enabled);
+    //! the sum of the squared gains of every sounding cell, see LoudnessControl::setVoicePower()
+    void setVoicePower(double gainSquaredSum);
+    const LoudnessControl& getLoudness() const;
+
+    //! moves waiting changes into the ring while it has room; call from the queueing thread once per generation
+    void flush();
+    //! changes waiting for room in the ring
+    size_t getPendingEventsCount() const;
+    //! changes replaced by a newer one while waiting
+    uint32_t getDroppedEventsCount() const;
+
+    //! as of the last rendered block
+    int getActiveVoicesCount() const;
+    int getPrunedVoicesCount() const;
+    int getDecimatedVoicesCount() const;
+
+    //! frames the bank delays its output by, as of the last rendered block, see OscillatorBank::getLatency()
+    size_t getLatency() const;
+
+    //! render times, deadline misses, voices and queue depth, readable from any thread
+    RenderStats& getRenderStats();
+};
+
+#endif /* OscillatorBankNode_h */
@@ -0,0 +1,187 @@
+//
+//  PeakTracker.cpp
+//  CASynthesis
+//
+//
+
+#include "PeakTracker.h"
+
+#include <math.h>
+#include <algorithm>
+
+const int PeakFrame::MAX_PEAKS;
+const size_t PeakTracker::FRAMES_CAPACITY;
+
+PeakFrame::PeakFrame()
+{
+    frame = 0;
+    count = 0;
+}
+
+PeakTracker::PeakTracker(double sampleRate, int fftSize, int hopSize)
+: mThreshold(-60.0f), mLowestFreq(20.0f), mFrames(FRAMES_CAPACITY), mDroppedFramesCount(0)
+{
+    mSampleRate = sampleRate;
+    resize(fftSize, hopSize);
+}
+
+void PeakTracker::resize(int fftSize, int hopSize)
+{
+    mFFTSize = fftSize;
+    mHopSize = std::max(1, std::min(hopSize, fftSize));
+    mFFT.resize(fftSize);
+
+    // periodic Hann, scaled so that a full scale sine peaks at a magnitude of 1
+    mWindow.resize(fftSize);
+    double sum = 0.0;
+    for (int k = 0; k < fftSize; ++k)
+    {
+        mWindow[k] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * k / fftSize));
+        sum += mWindow[k];
+    }
+    for (int k = 0; k < fftSize; ++k)
+        mWindow[k] = (float)(mWindow[k] * 2.0 / sum);
+
+    mInput.assign(fftSize, 0.0f);
+    mSpectrum.assign(fftSize, std::complex<float>(0.0f, 0.0f));
+    mMagnitude.assign(fftSize / 2 + 1, 0.0f);
+    mWritePosition = 0;
+    mHopCountdown = mHopSize;
+    mFrame = 0;
+}
+
+int PeakTracker::getFFTSize() const
+{
+    return mFFTSize;
+}
+
+int PeakTracker::getHopSize() const
+{
+    return mHopSize;
+}
+
+double PeakTracker::getSampleRate() const
+{
+    return mSampleRate;
+}
+
+void PeakTracker::setSampleRate(double sampleRate)
+{
+    mSampleRate = sampleRate;
+}
+
+float PeakTracker::getThreshold() const
+{
+    return mThreshold.load();
+}
+
+void PeakTracker::setThreshold(float thresholdDB)
+{
+    mThreshold = std::min(thresholdDB, -1.0f);
+}
+
+float PeakTracker::getLowestFreq() const
+{
+    return mLowestFreq.load();
+}
+
+void PeakTracker::setLowestFreq(float freq)
+{
+    mLowestFreq = freq;
+}
+
+void PeakTracker::process(const float* samples, size_t count)
+{
+    const size_t mask = mFFTSize - 1;
+    size_t done = 0;
+    while (done < count)
+    {
+        // up to the next hop, so a block of any size lines up with the same analysis frames
+        const size_t segment = std::min(count - done, (size_t)mHopCountdown);
+        for (size_t k = 0; k < segment; ++k)
+            mInput[(mWritePosition + k) & mask] = samples[done + k];
+        mWritePosition = (mWritePosition + segment) & mask;
+        mHopCountdown -= (int)segment;
+        mFrame += (int64_t)segment;
+        done += segment;
+
+        if (mHopCountdown == 0)
+        {
+            analyse();
+            mHopCountdown = mHopSize;
+        }
+    }
+}
+
+void PeakTracker::analyse()
+{
+    // the oldest sample sits at the write position
+    const size_t mask = mFFTSize - 1;
+    for (int k = 0; k < mFFTSize; ++k)
+        mSpectrum[k] = std::complex<float>(mInput[(mWritePosition + k) & mask] * mWindow[k], 0.0f);
+    mFFT.forward(mSpectrum.data());
+
+    const int binsCount = mFFTSize / 2;
+    for (int k = 0; k <= binsCount; ++k)
+        mMagnitude[k] = std::abs(mSpectrum[k]);
+
+    const float threshold = powf(10.0f, mThreshold.load() / 20.0f);
+    const float thresholdDB = mThreshold.load();
+    const float binWidth = (float)(mSampleRate / mFFTSize);
+    const int firstBin = std::max(1, (int)(mLowestFreq.load() / binWidth));
+
+    PeakFrame frame;
+    frame.frame = mFrame;
+    for (int k = firstBin; k < binsCount; ++k)
+    {
+        const float magnitude = mMagnitude[k];
+        if (magnitude < threshold || magnitude <= mMagnitude[k - 1] || magnitude < mMagnitude[k + 1])
+            continue;
+        if (frame.count == PeakFrame::MAX_PEAKS && magnitude <= frame.peaks[PeakFrame::MAX_PEAKS - 1].amp)
+            continue;
+
+        // the vertex of the parabola through the three bins' dB
+        const float before = 20.0f * log10f(std::max(mMagnitude[k - 1], 1e-12f));
+        const float at = 20.0f * log10f(magnitude);
+        const float after = 20.0f * log10f(std::max(mMagnitude[k + 1], 1e-12f));
+        const float curvature = before - 2.0f * at + after;
+        const float offset = (curvature < 0.0f) ? 0.5f * (before - after) / curvature : 0.0f;
+        const float peakDB = at - 0.25f * (before - after) * offset;
+
+        SpectralPeak peak;
+        peak.freq = (k + offset) * binWidth;
+        peak.amp = powf(10.0f, peakDB / 20.0f);
+        peak.level = std::min(std::max(1.0f - peakDB / thresholdDB, 0.0f), 1.0f);
+
+        // kept sorted loudest first, the quietest falling off the end
+        int position = std::min(frame.count, PeakFrame::MAX_PEAKS - 1);
+        while (position > 0 && frame.peaks[position - 1].amp < peak.amp)
+        {
+            frame.peaks[position] = frame.peaks[position - 1];
+            --position;
+        }
+        frame.peaks[position] = peak;
+        frame.count = std::min(frame.count + 1, PeakFrame::MAX_PEAKS);
+    }
+
+    if (!mFrames.push(frame))
+        mDroppedFramesCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool PeakTracker::pop(PeakFrame& frame)
+{
+    return mFrames.pop(frame);
+}
+
+bool PeakTracker::popLatest(PeakFrame& frame)
+{
+    bool popped = false;
+    while (mFrames.pop(frame))
+        popped = true;
+    return popped;
+}
+
+uint32_t PeakTracker::getDroppedFramesCount() const
+{
+    return mDroppedFramesCount.load(std::memory_order_relaxed);
+}
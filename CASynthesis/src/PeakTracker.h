@@ -0,0 +1,103 @@
+//
+//  PeakTracker.h
+//  CASynthesis
+//
+//
+
+#ifndef PeakTracker_h
+#define PeakTracker_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <complex>
+#include <vector>
+
+#include "FFT.h"
+#include "SpscRing.h"
+
+struct SpectralPeak
+{
+    float freq;
+    //! amplitude of the sine the peak stands for, 1 is full scale
+    float amp;
+    //! 0 at the tracker's threshold to 1 at full scale, linear in dB
+    float level;
+};
+
+// The loudest peaks of one analysis frame, loudest first
+struct PeakFrame
+{
+    static const int MAX_PEAKS = 16;
+
+    //! input frames analysed when the frame was taken
+    int64_t frame;
+    int count;
+    SpectralPeak peaks[MAX_PEAKS];
+
+    PeakFrame();
+};
+
+// Streaming STFT peak picker. Input arrives in blocks of any size; every hop the last fftSize samples are Hann
+// windowed and transformed, and local maxima of the magnitude spectrum above the threshold are refined by a
+// parabola through the log magnitudes of their three bins. Each frame's peaks go through a wait free ring to
+// one consumer. Everything is allocated in resize(), so process() never allocates, locks or waits, and the
+// cost of a block is at most one transform per hop it completes.
+class PeakTracker
+{
+protected:
+    double mSampleRate;
+    int mFFTSize;
+    int mHopSize;
+    std::atomic<float> mThreshold;
+    std::atomic<float> mLowestFreq;
+
+    FFT mFFT;
+    std::vector<float> mWindow;
+    std::vector<float> mInput;
+    std::vector<std::complex<float> > mSpectrum;
+    std::vector<float> mMagnitude;
+    size_t mWritePosition;
+    int mHopCountdown;
+    int64_t mFrame;
+
+    SpscRing<PeakFrame> mFrames;
+    std::atomic<uint32_t> mDroppedFramesCount;
+
+    void analyse();
+
+public:
+    //! frames kept for the consumer, a little over half a second of hops at the defaults
+    static const size_t FRAMES_CAPACITY = 128;
+
+    PeakTracker(double sampleRate = 44100.0, int fftSize = 2048, int hopSize = 256);
+
+    //! \a fftSize has to be a power of two; allocates, so only while process() is not running
+    void resize(int fftSize, int hopSize);
+    int getFFTSize() const;
+    int getHopSize() const;
+
+    double getSampleRate() const;
+    void setSampleRate(double sampleRate);
+
+    //! peaks quieter than this many dB below full scale are ignored
+    float getThreshold() const;
+    void setThreshold(float thresholdDB);
+
+    //! peaks below this frequency are ignored
+    float getLowestFreq() const;
+    void setLowestFreq(float freq);
+
+    //! producer side, the audio thread
+    void process(const float* samples, size_t count);
+
+    //! consumer side: the oldest frame waiting
+    bool pop(PeakFrame& frame);
+    //! consumer side: drops every frame but the newest
+    bool popLatest(PeakFrame& frame);
+
+    //! frames lost because the consumer fell behind
+    uint32_t getDroppedFramesCount() const;
+};
+
+#endif /* PeakTracker_h */
@@ -0,0 +1,34 @@
+//
+//  PeakTrackerNode.cpp
+//  CASynthesis
+//
+//
+
+#include "PeakTrackerNode.h"
+#include "RealtimeGuard.h"
+
+using namespace ci;
+
+PeakTrackerNode::PeakTrackerNode(int fftSize, int hopSize, const Format& format)
+: NodeAutoPullable(format), mTracker(44100.0, fftSize, hopSize)
+{
+    setChannelMode(ChannelMode::SPECIFIED);
+    setNumChannels(1);
+}
+
+void PeakTrackerNode::initialize()
+{
+    mTracker.setSampleRate(getSampleRate());
+}
+
+void PeakTrackerNode::process(audio::Buffer* buffer)
+{
+    RealtimeGuard::Scope realtime;
+
+    mTracker.process(buffer->getChannel(0), buffer->getNumFrames());
+}
+
+PeakTracker& PeakTrackerNode::getTracker()
+{
+    return mTracker;
+}
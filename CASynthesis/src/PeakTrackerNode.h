@@ -0,0 +1,33 @@
+//
+//  PeakTrackerNode.h
+//  CASynthesis
+//
+//
+
+#ifndef PeakTrackerNode_h
+#define PeakTrackerNode_h
+
+#include "cinder/audio/Node.h"
+
+#include "PeakTracker.h"
+
+typedef std::shared_ptr<class PeakTrackerNode> PeakTrackerNodeRef;
+
+// Picks spectral peaks from whatever is connected to it, usually the input device, mixed down to mono. The node
+// is pulled by the context on its own, so it needs no path to the output, and passes its input through unchanged.
+// Peaks are read on one other thread through getTracker(), typically at generation boundaries.
+class PeakTrackerNode : public ci::audio::NodeAutoPullable
+{
+protected:
+    PeakTracker mTracker;
+
+    void initialize() override;
+    void process(ci::audio::Buffer* buffer) override;
+
+public:
+    PeakTrackerNode(int fftSize = 2048, int hopSize = 256, const Format& format = Format());
+
+    PeakTracker& getTracker();
+};
+
+#endif /* PeakTrackerNode_h */
@@ -0,0 +1,34 @@
+//
+//  Psychoacoustics.cpp
+//  CASynthesis
+//
+//
+
+#include "Psychoacoustics.h"
+
+#include <math.h>
+
+namespace psychoacoustics
+{
+    float bark(float freq)
+    {
+        return 13.0f * atanf(0.00076f * freq) + 3.5f * atanf((freq / 7500.0f) * (freq / 7500.0f));
+    }
+
+    float absoluteThreshold(float freq)
+    {
+        float khz = fmaxf(freq, 20.0f) / 1000.0f;
+        return 3.64f * powf(khz, -0.8f) - 6.5f * expf(-0.6f * (khz - 3.3f) * (khz - 3.3f)) + 0.001f * khz * khz * khz * khz;
+    }
+
+    float spreading(float deltaBark)
+    {
+        float shifted = deltaBark + 0.474f;
+        return 15.81f + 7.5f * shifted - 17.5f * sqrtf(1.0f + shifted * shifted);
+    }
+
+    float tonalMaskingOffset(float bark)
+    {
+        return 14.5f + bark;
+    }
+}
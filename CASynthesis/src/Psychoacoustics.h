@@ -0,0 +1,27 @@
+//
+//  Psychoacoustics.h
+//  CASynthesis
+//
+//
+
+#ifndef Psychoacoustics_h
+#define Psychoacoustics_h
+
+namespace psychoacoustics
+{
+    static const int BARK_BANDS = 25;
+
+    //! critical band rate of \a freq, Zwicker & Terhardt
+    float bark(float freq);
+
+    //! threshold in quiet for a tone at \a freq in dB SPL, Terhardt
+    float absoluteThreshold(float freq);
+
+    //! masking a tone spreads onto a tone \a deltaBark critical bands above it, in dB, Schroeder
+    float spreading(float deltaBark);
+
+    //! how far below a tonal masker at \a bark its masking threshold sits, in dB
+    float tonalMaskingOffset(float bark);
+}
+
+#endif /* Psychoacoustics_h */
@@ -0,0 +1,365 @@
+//
+//  RealtimeCheck.cpp
+//  CASynthesis
+//
+//
+
+// Synthetic driver for RealtimeGuard: an audio thread renders blocks back to back, as fast as it can, doing
+// what OscillatorBankNode::process() does, while the main thread steps the automaton and feeds it voice
+// changes through the same ring, and now and then flips the settings the node hands over every block.
+// Built with CA_REALTIME_GUARD, every allocation, lock or sleep on the audio thread is reported with a
+// backtrace; the exit status is 1 when there were any, so it can guard against regressions.
+//
+//  RealtimeCheck --seconds 30 --size 16 --threads 4
+//  RealtimeCheck --automaton --size 8
+//  RealtimeCheck --input --block 64
+
+#include "CAKernel.h"
+#include "OscillatorBank.h"
+#include "SpectralSynth.h"
+#include "SpscRing.h"
+#include "PeakTracker.h"
+#include "LoudnessControl.h"
+#include "RealtimeGuard.h"
+#include "RenderStats.h"
+#include "Defines.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const char* getArg(const std::vector<std::string>& args, const char* name, const char* fallback)
+{
+    std::vector<std::string>::const_iterator arg = std::find(args.begin(), args.end(), name);
+    if (arg != args.end() && arg + 1 != args.end())
+        return (arg + 1)->c_str();
+    return fallback;
+}
+
+static bool hasArg(const std::vector<std::string>& args, const char* name)
+{
+    return std::find(args.begin(), args.end(), name) != args.end();
+}
+
+static void printUsage()
+{
+    printf("usage: RealtimeCheck [options]\n"
+           "  --seconds s        audio to render (30)\n"
+           "  --rate hz          sample rate (48000)\n"
+           "  --block frames     frames per block (256)\n"
+           "  --size n           grid side (16)\n"
+           "  --voices n         voice pool size, 0 for one per cell (0)\n"
+           "  --engine spectral  inverse FFT synthesis instead of oscillators\n"
+           "  --layout name      stereo, quad, ring8 or foa (stereo)\n"
+           "  --threads n        bank threads including the audio thread (1)\n"
+           "  --automaton        step the grid on the audio thread, as AutomatonNode does\n"
+           "  --input            track peaks of a synthetic input on the audio thread and seed every generation\n"
+           "  --abort            abort on the first violation instead of logging\n");
+}
+
+// what the node copies into the bank at the start of every block
+struct Settings
+{
+    std::atomic<int> glideShape;
+    std::atomic<int> rampShape;
+    std::atomic<int> sineAccuracy;
+    std::atomic<size_t> controlFrames;
+    std::atomic<bool> pruningEnabled;
+    std::atomic<bool> multirateEnabled;
+
+    Settings()
+    : glideShape(OscillatorBank::GLIDE_LINEAR), rampShape(OscillatorBank::RAMP_LINEAR), sineAccuracy(fastsine::ACCURACY_HIGH),
+      controlFrames(CONTROL_STEP_FRAMES), pruningEnabled(true), multirateEnabled(true)
+    {
+    }
+};
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> args(argv + 1, argv + argc);
+    if (hasArg(args, "--help") || hasArg(args, "-h"))
+    {
+        printUsage();
+        return 0;
+    }
+
+    const double seconds = std::max(0.0, atof(getArg(args, "--seconds", "30")));
+    const int sampleRate = std::max(1, atoi(getArg(args, "--rate", "48000")));
+    const size_t blockFrames = std::max(1, atoi(getArg(args, "--block", "256")));
+    const int gridSize = std::max(1, atoi(getArg(args, "--size", "16")));
+    const int voicesCount = std::max(0, atoi(getArg(args, "--voices", "0")));
+    const bool spectral = std::string(getArg(args, "--engine", "")) == "spectral";
+    const int threadCount = std::max(1, atoi(getArg(args, "--threads", "1")));
+    const bool automaton = hasArg(args, "--automaton");
+    const bool input = hasArg(args, "--input");
+    SpeakerLayout::Type layout = SpeakerLayout::LAYOUT_STEREO;
+    if (!SpeakerLayout::parse(getArg(args, "--layout", "stereo"), layout))
+    {
+        fprintf(stderr, "unknown layout %s\n", getArg(args, "--layout", ""));
+        return 1;
+    }
+
+    if (!RealtimeGuard::isEnabled())
+        fprintf(stderr, "built without CA_REALTIME_GUARD, nothing is checked\n");
+    RealtimeGuard::setAction(hasArg(args, "--abort") ? RealtimeGuard::ACTION_ABORT : RealtimeGuard::ACTION_LOG);
+
+    // everything the audio thread touches is built here, before it starts
+    CAKernel kernel(gridSize);
+    const int cellsCount = kernel.getCellsCount();
+
+    std::unique_ptr<OscillatorBank> bank;
+    if (spectral)
+        bank.reset(new SpectralSynth(cellsCount, voicesCount, sampleRate));
+    else
+        bank.reset(new OscillatorBank(cellsCount, voicesCount, sampleRate));
+    bank->setThreadCount(threadCount);
+    bank->setLayout(SpeakerLayout(layout));
+    bank->setWavetable(1, Wavetable(Wavetable::SHAPE_SAW));
+    bank->setWavetable(2, Wavetable(Wavetable::SHAPE_SQUARE));
+
+    srand(1);
+    const CARule& rule = kernel.getRule();
+    const float norm = 1.0f / cellsCount;
+    for (int v = 0; v < cellsCount; ++v)
+    {
+        float amp = (float)rand() / RAND_MAX;
+        float freq = (float)pow(2.0, log2(rule.lowestFreq) + (log2(rule.highestFreq) - log2(rule.lowestFreq)) * ((double)rand() / RAND_MAX));
+        kernel.setCell(v / gridSize, v % gridSize, amp, freq);
+
+        VoiceEvent event;
+        event.cell = v;
+        event.rampFrames = 0;
+        event.frame = 0;
+
+        event.type = VoiceEvent::FREQ;
+        event.value = freq;
+        bank->apply(event);
+        event.type = VoiceEvent::GAIN;
+        event.value = amp * norm;
+        bank->apply(event);
+    }
+
+    // a stand in for an instrument: three partials drifting a fifth apart, and the tracker that listens to them
+    PeakTracker tracker(sampleRate);
+    std::vector<float> inputBuffer(blockFrames);
+    double inputPhase[3] = {0.0, 0.0, 0.0};
+
+    SpscRing<VoiceEvent> events(std::max(cellsCount * 8, 1024));
+    LoudnessControl loudness(sampleRate);
+    Settings settings;
+    std::atomic<uint64_t> renderedFrames(0);
+    std::atomic<uint64_t> scheduledFrames(0);
+    RenderStats stats;
+
+    const uint64_t totalFrames = (uint64_t)(seconds * sampleRate + 0.5);
+    const size_t stepFrames = std::max<size_t>(1, (size_t)(STEP_TIME * sampleRate + 0.5));
+    const uint32_t rampFrames = (uint32_t)(ATTACK_TIME * sampleRate + 0.5);
+
+    const int channelsCount = bank->getChannelsCount();
+    std::vector<float> buffers(blockFrames * channelsCount);
+    std::vector<float*> channels(channelsCount);
+    for (int channel = 0; channel < channelsCount; ++channel)
+        channels[channel] = &buffers[channel * blockFrames];
+
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point start = Clock::now();
+
+    std::thread audio([&]()
+    {
+        RealtimeGuard::Scope realtime;
+
+        size_t framesUntilStep = 0;
+        for (uint64_t frame = 0; frame < totalFrames; frame += blockFrames)
+        {
+            // blocks wait for the main thread's generations, however fast they render, so every run sees all of
+            // them; yielding is a hint to the scheduler, not a wait on anything
+            while (!automaton && scheduledFrames.load() < frame + blockFrames)
+                std::this_thread::yield();
+
+            bank->setGlideShape((OscillatorBank::GlideShape)settings.glideShape.load());
+            bank->setSineAccuracy((fastsine::Accuracy)settings.sineAccuracy.load());
+            bank->setRampShape((OscillatorBank::RampShape)settings.rampShape.load());
+            bank->setControlFrames(settings.controlFrames);
+            bank->setPruningEnabled(settings.pruningEnabled);
+            bank->setMultirateEnabled(settings.multirateEnabled);
+
+            const Clock::time_point blockStart = Clock::now();
+
+            VoiceEvent event;
+            int queueDepth = 0;
+            while (events.pop(event))
+            {
+                bank->apply(event);
+                ++queueDepth;
+            }
+
+            if (input)
+            {
+                for (size_t k = 0; k < blockFrames; ++k)
+                {
+                    const double base = 220.0 * pow(2.0, sin(2.0 * M_PI * (frame + k) / (8.0 * sampleRate)));
+                    inputBuffer[k] = 0.0f;
+                    for (int p = 0; p < 3; ++p)
+                    {
+                        inputPhase[p] += base * pow(1.5, p) / sampleRate;
+                        inputPhase[p] -= floor(inputPhase[p]);
+                        inputBuffer[k] += (float)(0.25 * sin(2.0 * M_PI * inputPhase[p]));
+                    }
+                }
+                tracker.process(inputBuffer.data(), blockFrames);
+            }
+
+            std::fill(buffers.begin(), buffers.end(), 0.0f);
+            if (!automaton)
+            {
+                bank->render(channels.data(), blockFrames);
+            }
+            else
+            {
+                // AutomatonNode::process(): a generation whenever one falls due, ramps spanning the whole step
+                size_t done = 0;
+                while (done < blockFrames)
+                {
+                    if (framesUntilStep == 0)
+                    {
+                        kernel.step();
+                        framesUntilStep = stepFrames;
+
+                        event.frame = bank->getFrame();
+                        event.rampFrames = (uint32_t)stepFrames;
+                        for (int v = 0; v < cellsCount; ++v)
+                        {
+                            event.cell = v;
+                            event.type = VoiceEvent::FREQ;
+                            event.value = kernel.getFreqs()[v];
+                            bank->apply(event);
+                            event.type = VoiceEvent::GAIN;
+                            event.value = kernel.getAmps()[v] * norm;
+                            bank->apply(event);
+                        }
+                    }
+
+                    size_t segment = std::min(blockFrames - done, framesUntilStep);
+                    float* segmentChannels[SpeakerLayout::MAX_CHANNELS];
+                    for (int channel = 0; channel < channelsCount; ++channel)
+                        segmentChannels[channel] = channels[channel] + done;
+                    bank->render(segmentChannels, segment);
+
+                    done += segment;
+                    framesUntilStep -= segment;
+                }
+            }
+            loudness.process(channels.data(), channelsCount, blockFrames);
+
+            stats.addBlock(std::chrono::duration<double>(Clock::now() - blockStart).count(), (double)blockFrames / sampleRate);
+            stats.setVoices(bank->getActiveVoicesCount(), bank->getPrunedCount(), bank->getDecimatedCount());
+            stats.setQueueDepth(queueDepth);
+            renderedFrames.store(frame + blockFrames);
+        }
+    });
+
+    // the main thread stands in for the UI: generations a step ahead of the audio thread, and every tenth one
+    // something the node would pass on from a key press
+    uint64_t generations = 0;
+    uint64_t nextStepFrame = 0;
+    while (renderedFrames.load() < totalFrames)
+    {
+        if (automaton || renderedFrames.load() + blockFrames + stepFrames < nextStepFrame)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::vector<float> amps(kernel.getAmps(), kernel.getAmps() + cellsCount);
+        std::vector<float> freqs(kernel.getFreqs(), kernel.getFreqs() + cellsCount);
+        kernel.step();
+        ++generations;
+
+        PeakFrame peaks;
+        if (input && tracker.popLatest(peaks))
+            for (int k = 0; k < peaks.count; ++k)
+                kernel.seedPartial(peaks.peaks[k].freq, peaks.peaks[k].level);
+        loudness.setVoicePower(kernel.getAmpSquaredSum() * norm * norm);
+
+        VoiceEvent event;
+        event.frame = (int64_t)nextStepFrame;
+        event.rampFrames = rampFrames;
+        for (int v = 0; v < cellsCount; ++v)
+        {
+            event.cell = v;
+            if (kernel.getFreqs()[v] != freqs[v])
+            {
+                event.type = VoiceEvent::FREQ;
+                event.value = kernel.getFreqs()[v];
+                if (!events.push(event))
+                    stats.addDroppedEvent();
+            }
+            if (kernel.getAmps()[v] != amps[v])
+            {
+                event.type = VoiceEvent::GAIN;
+                event.value = kernel.getAmps()[v] * norm;
+                if (!events.push(event))
+                    stats.addDroppedEvent();
+            }
+        }
+
+        if (generations % 10 == 0)
+        {
+            const int change = (int)(generations / 10) % 7;
+            if (change == 0)
+                settings.glideShape = 1 - settings.glideShape;
+            else if (change == 1)
+                settings.rampShape = 1 - settings.rampShape;
+            else if (change == 2)
+                settings.controlFrames = (settings.controlFrames == CONTROL_STEP_FRAMES) ? CONTROL_STEP_FRAMES * 4 : CONTROL_STEP_FRAMES;
+            else if (change == 3)
+                settings.pruningEnabled = !settings.pruningEnabled;
+            else if (change == 4)
+                settings.multirateEnabled = !settings.multirateEnabled;
+
+            event.cell = rand() % cellsCount;
+            event.type = (change == 5) ? VoiceEvent::TRANSPOSE : VoiceEvent::PAN;
+            event.value = (change == 5) ? (float)pow(2.0, (rand() % 13) / 12.0) : (float)rand() / RAND_MAX;
+            if (!events.push(event))
+                stats.addDroppedEvent();
+
+            // a third of the grid changes waveform at once
+            for (int v = 0; v < cellsCount && change == 6; v += 3)
+            {
+                event.cell = (v + (int)(generations / 70)) % cellsCount;
+                event.type = VoiceEvent::WAVE;
+                event.value = (float)(rand() % 3);
+                if (!events.push(event))
+                    stats.addDroppedEvent();
+            }
+        }
+
+        nextStepFrame += stepFrames;
+        scheduledFrames.store(nextStepFrame);
+    }
+
+    audio.join();
+
+    const double wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    const double audioSeconds = (double)totalFrames / sampleRate;
+    const RenderStats::Snapshot snapshot = stats.getSnapshot();
+    printf("%llu blocks of %d frames, %.1fx realtime, %llu generations from the main thread, %u events dropped\n",
+           (unsigned long long)snapshot.blocksCount, (int)blockFrames,
+           audioSeconds / std::max(wallSeconds, 1e-9), (unsigned long long)generations, snapshot.droppedEventsCount);
+    printf("block load mean %.1f%%, p99 %.1f%%, peak %.1f%%, queue depth peak %d\n",
+           100.0 * snapshot.getMeanLoad(), 100.0 * snapshot.getLoadPercentile(0.99), 100.0 * snapshot.peakLoad, snapshot.peakQueueDepth);
+
+    if (input)
+        printf("%u peak frames dropped\n", tracker.getDroppedFramesCount());
+
+    const uint32_t violations = RealtimeGuard::getViolationsCount();
+    printf("%u realtime violations on the audio thread\n", violations);
+    return (violations > 0) ? 1 : 0;
+}
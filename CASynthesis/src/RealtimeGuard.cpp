@@ -0,0 +1,475 @@
+//
+//  RealtimeGuard.cpp
+//  CASynthesis
+//
+//
+
+#include "RealtimeGuard.h"
+
+#if defined(CA_REALTIME_GUARD)
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <new>
+
+const uint32_t RealtimeGuard::MAX_REPORTS;
+
+// the thread's state lives in a pthread key rather than thread_local, whose first use may itself allocate
+static const intptr_t DEPTH_MASK = 0xff;
+static const intptr_t ALLOW_UNIT = 0x100;
+static const intptr_t ALLOW_MASK = 0xff00;
+static const intptr_t REPORTING = 0x10000;
+
+static pthread_key_t sStateKey;
+static pthread_once_t sStateOnce = PTHREAD_ONCE_INIT;
+static std::atomic<uint32_t> sViolationsCount(0);
+static std::atomic<int> sAction(RealtimeGuard::ACTION_LOG);
+
+static void createStateKey()
+{
+    pthread_key_create(&sStateKey, NULL);
+}
+
+static intptr_t getState()
+{
+    pthread_once(&sStateOnce, createStateKey);
+    return (intptr_t)pthread_getspecific(sStateKey);
+}
+
+static void setState(intptr_t state)
+{
+    pthread_setspecific(sStateKey, (void*)state);
+}
+
+static void report(const char* call)
+{
+    const uint32_t count = ++sViolationsCount;
+    if (count <= RealtimeGuard::MAX_REPORTS)
+    {
+        // nothing here may allocate before the backtrace is out; the guard is off for this thread meanwhile
+        char line[160];
+        int length = snprintf(line, sizeof(line), "realtime violation %u: %s on the audio thread\n", count, call);
+        write(STDERR_FILENO, line, length);
+
+        void* frames[64];
+        int framesCount = backtrace(frames, 64);
+        backtrace_symbols_fd(frames, framesCount, STDERR_FILENO);
+
+        if (count == RealtimeGuard::MAX_REPORTS)
+        {
+            length = snprintf(line, sizeof(line), "further violations are only counted\n");
+            write(STDERR_FILENO, line, length);
+        }
+    }
+
+    if (sAction.load() == RealtimeGuard::ACTION_ABORT)
+        abort();
+}
+
+static void check(const char* call)
+{
+    const intptr_t state = getState();
+    if ((state & DEPTH_MASK) == 0 || (state & (ALLOW_MASK | REPORTING)) != 0)
+        return;
+
+    setState(state | REPORTING);
+    report(call);
+    setState(state);
+}
+
+RealtimeGuard::Scope::Scope(bool enabled)
+{
+    mEnabled = enabled;
+    if (mEnabled)
+        setState(getState() + 1);
+}
+
+RealtimeGuard::Scope::~Scope()
+{
+    if (mEnabled)
+        setState(getState() - 1);
+}
+
+RealtimeGuard::Allow::Allow()
+{
+    setState(getState() + ALLOW_UNIT);
+}
+
+RealtimeGuard::Allow::~Allow()
+{
+    setState(getState() - ALLOW_UNIT);
+}
+
+bool RealtimeGuard::isRealtimeThread()
+{
+    const intptr_t state = getState();
+    return (state & DEPTH_MASK) != 0 && (state & ALLOW_MASK) == 0;
+}
+
+void RealtimeGuard::setAction(Action action)
+{
+    sAction = action;
+}
+
+uint32_t RealtimeGuard::getViolationsCount()
+{
+    return sViolationsCount.load();
+}
+
+#if defined(__GLIBC__)
+
+// glibc lets the executable's own definitions win over libc's and keeps the originals under these names; the
+// rest are looked up once at start up, since dlsym may allocate
+extern "C"
+{
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* pointer, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void* pointer);
+}
+
+typedef int (*MutexLockFunction)(pthread_mutex_t*);
+typedef int (*NanosleepFunction)(const struct timespec*, struct timespec*);
+typedef int (*UsleepFunction)(useconds_t);
+typedef ssize_t (*ReadFunction)(int, void*, size_t);
+typedef ssize_t (*WriteFunction)(int, const void*, size_t);
+
+static MutexLockFunction sMutexLock;
+static NanosleepFunction sNanosleep;
+static UsleepFunction sUsleep;
+static ReadFunction sRead;
+static WriteFunction sWrite;
+
+template <typename Function>
+static Function getNext(Function& function, const char* name)
+{
+    if (function == NULL)
+        function = (Function)dlsym(RTLD_NEXT, name);
+    return function;
+}
+
+static struct StartUp
+{
+    StartUp()
+    {
+        getNext(sMutexLock, "pthread_mutex_lock");
+        getNext(sNanosleep, "nanosleep");
+        getNext(sUsleep, "usleep");
+        getNext(sRead, "read");
+        getNext(sWrite, "write");
+
+        // the first backtrace loads the unwinder, which is better done now than in the middle of a report
+        void* frame;
+        backtrace(&frame, 1);
+    }
+} sStartUp;
+
+static void* realMalloc(size_t size)
+{
+    return __libc_malloc(size);
+}
+
+#if defined(__cpp_aligned_new)
+static void* realMemalign(size_t alignment, size_t size)
+{
+    return __libc_memalign(alignment, size);
+}
+#endif
+
+static void realFree(void* pointer)
+{
+    __libc_free(pointer);
+}
+
+extern "C"
+{
+    void* malloc(size_t size)
+    {
+        check("malloc");
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size)
+    {
+        check("calloc");
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* pointer, size_t size)
+    {
+        check("realloc");
+        return __libc_realloc(pointer, size);
+    }
+
+    int posix_memalign(void** pointer, size_t alignment, size_t size)
+    {
+        check("posix_memalign");
+        *pointer = __libc_memalign(alignment, size);
+        return (*pointer != NULL || size == 0) ? 0 : ENOMEM;
+    }
+
+    void free(void* pointer)
+    {
+        if (pointer != NULL)
+            check("free");
+        __libc_free(pointer);
+    }
+
+    int pthread_mutex_lock(pthread_mutex_t* mutex)
+    {
+        check("pthread_mutex_lock");
+        return getNext(sMutexLock, "pthread_mutex_lock")(mutex);
+    }
+
+    int nanosleep(const struct timespec* duration, struct timespec* remaining)
+    {
+        check("nanosleep");
+        return getNext(sNanosleep, "nanosleep")(duration, remaining);
+    }
+
+    int usleep(useconds_t microseconds)
+    {
+        check("usleep");
+        return getNext(sUsleep, "usleep")(microseconds);
+    }
+
+    ssize_t read(int file, void* data, size_t size)
+    {
+        check("read");
+        return getNext(sRead, "read")(file, data, size);
+    }
+
+    ssize_t write(int file, const void* data, size_t size)
+    {
+        check("write");
+        return getNext(sWrite, "write")(file, data, size);
+    }
+}
+
+#elif defined(__APPLE__)
+
+// calls from this file go to the originals, interpose tuples do not apply to the image that declares them
+#define INTERPOSE(replacement, original) \
+    __attribute__((used)) static const struct { const void* replacement; const void* original; } sInterpose_##original \
+    __attribute__((section("__DATA,__interpose"))) = { (const void*)(uintptr_t)&replacement, (const void*)(uintptr_t)&original };
+
+static void* realMalloc(size_t size)
+{
+    return malloc(size);
+}
+
+#if defined(__cpp_aligned_new)
+static void* realMemalign(size_t alignment, size_t size)
+{
+    void* pointer;
+    return (posix_memalign(&pointer, alignment, size) == 0) ? pointer : NULL;
+}
+#endif
+
+static void realFree(void* pointer)
+{
+    free(pointer);
+}
+
+static void* guardMalloc(size_t size)
+{
+    check("malloc");
+    return malloc(size);
+}
+
+static void* guardCalloc(size_t count, size_t size)
+{
+    check("calloc");
+    return calloc(count, size);
+}
+
+static void* guardRealloc(void* pointer, size_t size)
+{
+    check("realloc");
+    return realloc(pointer, size);
+}
+
+static int guardPosixMemalign(void** pointer, size_t alignment, size_t size)
+{
+    check("posix_memalign");
+    return posix_memalign(pointer, alignment, size);
+}
+
+static void guardFree(void* pointer)
+{
+    if (pointer != NULL)
+        check("free");
+    free(pointer);
+}
+
+static int guardMutexLock(pthread_mutex_t* mutex)
+{
+    check("pthread_mutex_lock");
+    return pthread_mutex_lock(mutex);
+}
+
+static int guardNanosleep(const struct timespec* duration, struct timespec* remaining)
+{
+    check("nanosleep");
+    return nanosleep(duration, remaining);
+}
+
+static int guardUsleep(useconds_t microseconds)
+{
+    check("usleep");
+    return usleep(microseconds);
+}
+
+static ssize_t guardRead(int file, void* data, size_t size)
+{
+    check("read");
+    return read(file, data, size);
+}
+
+static ssize_t guardWrite(int file, const void* data, size_t size)
+{
+    check("write");
+    return write(file, data, size);
+}
+
+INTERPOSE(guardMalloc, malloc)
+INTERPOSE(guardCalloc, calloc)
+INTERPOSE(guardRealloc, realloc)
+INTERPOSE(guardPosixMemalign, posix_memalign)
+INTERPOSE(guardFree, free)
+INTERPOSE(guardMutexLock, pthread_mutex_lock)
+INTERPOSE(guardNanosleep, nanosleep)
+INTERPOSE(guardUsleep, usleep)
+INTERPOSE(guardRead, read)
+INTERPOSE(guardWrite, write)
+
+#else
+#error "RealtimeGuard needs glibc or macOS"
+#endif
+
+// replaced the standard way, so these are seen wherever the file is linked
+void* operator new(size_t size)
+{
+    check("operator new");
+    void* pointer = realMalloc(size > 0 ? size : 1);
+    if (pointer == NULL)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    check("operator new");
+    return realMalloc(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& nothrow) noexcept
+{
+    return operator new(size, nothrow);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    if (pointer != NULL)
+        check("operator delete");
+    realFree(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+    operator delete(pointer);
+}
+
+#if defined(__cpp_sized_deallocation)
+void operator delete(void* pointer, size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+    operator delete(pointer);
+}
+#endif
+
+#if defined(__cpp_aligned_new)
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    check("operator new");
+    void* pointer = realMemalign((size_t)alignment, size > 0 ? size : 1);
+    if (pointer == NULL)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    check("operator new");
+    return realMemalign((size_t)alignment, size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t& nothrow) noexcept
+{
+    return operator new(size, alignment, nothrow);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    operator delete(pointer);
+}
+#endif
+
+#endif
@@ -0,0 +1,77 @@
+//
+//  RealtimeGuard.h
+//  CASynthesis
+//
+//
+
+#ifndef RealtimeGuard_h
+#define RealtimeGuard_h
+
+#include <stdint.h>
+
+// Debug check for the audio path. Code that must not wait opens a Scope; built with CA_REALTIME_GUARD defined,
+// any allocation, free, mutex lock (and so any condition wait), sleep, read or write made on that thread while
+// the scope is open is reported on stderr with a backtrace, or aborts. Without the define every call is empty.
+//
+// operator new and delete are replaced everywhere. The C functions are interposed: with glibc by defining them in
+// the executable, on macOS by dyld interpose tuples, which dyld only honours in a library inserted at launch, so
+// there RealtimeGuard.cpp has to be built into a dylib and run with DYLD_INSERT_LIBRARIES to see them.
+class RealtimeGuard
+{
+public:
+    enum Action
+    {
+        ACTION_LOG,
+        ACTION_ABORT
+    };
+
+    //! only the first this many violations print a backtrace, the rest are counted
+    static const uint32_t MAX_REPORTS = 16;
+
+#if defined(CA_REALTIME_GUARD)
+    //! marks the current thread as rendering audio while in scope; scopes nest
+    class Scope
+    {
+        bool mEnabled;
+
+    public:
+        Scope(bool enabled = true);
+        ~Scope();
+    };
+
+    //! lifts the check for a wait that is known to be bounded
+    class Allow
+    {
+    public:
+        Allow();
+        ~Allow();
+    };
+
+    static bool isEnabled() { return true; }
+    static bool isRealtimeThread();
+
+    static void setAction(Action action);
+    static uint32_t getViolationsCount();
+#else
+    class Scope
+    {
+    public:
+        Scope(bool = true) {}
+    };
+
+    class Allow
+    {
+    public:
+        Allow() {}
+        ~Allow() {}
+    };
+
+    static bool isEnabled() { return false; }
+    static bool isRealtimeThread() { return false; }
+
+    static void setAction(Action) {}
+    static uint32_t getViolationsCount() { return 0; }
+#endif
+};
+
+#endif /* RealtimeGuard_h */
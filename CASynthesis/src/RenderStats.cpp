@@ -0,0 +1,176 @@
+//
+//  RenderStats.cpp
+//  CASynthesis
+//
+//
+
+#include "RenderStats.h"
+
+#include <string.h>
+#include <algorithm>
+
+const int RenderStats::HISTOGRAM_BINS;
+const int RenderStats::BINS_PER_DEADLINE;
+
+RenderStats::Snapshot::Snapshot()
+{
+    blocksCount = 0;
+    deadlineMissesCount = 0;
+    memset(histogram, 0, sizeof(histogram));
+    renderSeconds = 0.0;
+    deadlineSeconds = 0.0;
+    peakLoad = 0.0f;
+
+    activeVoicesCount = 0;
+    prunedVoicesCount = 0;
+    decimatedVoicesCount = 0;
+    queueDepth = 0;
+    peakQueueDepth = 0;
+    droppedEventsCount = 0;
+}
+
+double RenderStats::Snapshot::getMeanLoad() const
+{
+    return deadlineSeconds > 0.0 ? renderSeconds / deadlineSeconds : 0.0;
+}
+
+double RenderStats::Snapshot::getLoadPercentile(double fraction) const
+{
+    // the upper edge of the bin the fraction falls in, so the answer errs on the heavy side, but never past the peak
+    uint64_t total = 0;
+    for (int k = 0; k < HISTOGRAM_BINS; ++k)
+        total += histogram[k];
+    if (total == 0)
+        return 0.0;
+
+    const double wanted = fraction * total;
+    uint64_t count = 0;
+    for (int k = 0; k < HISTOGRAM_BINS - 1; ++k)
+    {
+        count += histogram[k];
+        if (count >= wanted)
+            return std::min((double)(k + 1) / BINS_PER_DEADLINE, (double)peakLoad);
+    }
+    return std::max((double)peakLoad, (double)(HISTOGRAM_BINS - 1) / BINS_PER_DEADLINE);
+}
+
+void RenderStats::Snapshot::write(std::ostream& out) const
+{
+    out << "blocks," << blocksCount << "\n";
+    out << "deadline_misses," << deadlineMissesCount << "\n";
+    out << "render_seconds," << renderSeconds << "\n";
+    out << "deadline_seconds," << deadlineSeconds << "\n";
+    out << "mean_load," << getMeanLoad() << "\n";
+    out << "p99_load," << getLoadPercentile(0.99) << "\n";
+    out << "peak_load," << peakLoad << "\n";
+    out << "active_voices," << activeVoicesCount << "\n";
+    out << "pruned_voices," << prunedVoicesCount << "\n";
+    out << "decimated_voices," << decimatedVoicesCount << "\n";
+    out << "queue_depth," << queueDepth << "\n";
+    out << "peak_queue_depth," << peakQueueDepth << "\n";
+    out << "dropped_events," << droppedEventsCount << "\n";
+    for (int k = 0; k < HISTOGRAM_BINS; ++k)
+        out << "load_" << 100 * k / BINS_PER_DEADLINE << "," << histogram[k] << "\n";
+}
+
+RenderStats::RenderStats()
+{
+    for (int k = 0; k < HISTOGRAM_BINS; ++k)
+        mHistogram[k] = 0;
+    mActiveVoicesCount = 0;
+    mPrunedVoicesCount = 0;
+    mDecimatedVoicesCount = 0;
+    reset();
+}
+
+void RenderStats::addBlock(double renderSeconds, double deadlineSeconds)
+{
+    const std::memory_order relaxed = std::memory_order_relaxed;
+    const float load = (deadlineSeconds > 0.0) ? (float)(renderSeconds / deadlineSeconds) : 0.0f;
+    const int bin = std::min((int)(load * BINS_PER_DEADLINE), HISTOGRAM_BINS - 1);
+
+    // single writer, so plain load and store pairs are enough and cheaper than read-modify-write
+    mHistogram[bin].store(mHistogram[bin].load(relaxed) + 1, relaxed);
+    mRenderNanoseconds.store(mRenderNanoseconds.load(relaxed) + (uint64_t)(renderSeconds * 1e9), relaxed);
+    mDeadlineNanoseconds.store(mDeadlineNanoseconds.load(relaxed) + (uint64_t)(deadlineSeconds * 1e9), relaxed);
+    if (load > 1.0f)
+        mDeadlineMissesCount.store(mDeadlineMissesCount.load(relaxed) + 1, relaxed);
+    if (load > mPeakLoad.load(relaxed))
+        mPeakLoad.store(load, relaxed);
+    mBlocksCount.store(mBlocksCount.load(relaxed) + 1, relaxed);
+}
+
+void RenderStats::setVoices(int activeCount, int prunedCount, int decimatedCount)
+{
+    mActiveVoicesCount.store(activeCount, std::memory_order_relaxed);
+    mPrunedVoicesCount.store(prunedCount, std::memory_order_relaxed);
+    mDecimatedVoicesCount.store(decimatedCount, std::memory_order_relaxed);
+}
+
+void RenderStats::setQueueDepth(int depth)
+{
+    mQueueDepth.store(depth, std::memory_order_relaxed);
+    if (depth > mPeakQueueDepth.load(std::memory_order_relaxed))
+        mPeakQueueDepth.store(depth, std::memory_order_relaxed);
+}
+
+void RenderStats::addDroppedEvent()
+{
+    mDroppedEventsCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+int RenderStats::getActiveVoicesCount() const
+{
+    return mActiveVoicesCount.load(std::memory_order_relaxed);
+}
+
+int RenderStats::getPrunedVoicesCount() const
+{
+    return mPrunedVoicesCount.load(std::memory_order_relaxed);
+}
+
+int RenderStats::getDecimatedVoicesCount() const
+{
+    return mDecimatedVoicesCount.load(std::memory_order_relaxed);
+}
+
+uint32_t RenderStats::getDroppedEventsCount() const
+{
+    return mDroppedEventsCount.load(std::memory_order_relaxed);
+}
+
+RenderStats::Snapshot RenderStats::getSnapshot() const
+{
+    const std::memory_order relaxed = std::memory_order_relaxed;
+
+    Snapshot snapshot;
+    snapshot.blocksCount = mBlocksCount.load(relaxed);
+    snapshot.deadlineMissesCount = mDeadlineMissesCount.load(relaxed);
+    for (int k = 0; k < HISTOGRAM_BINS; ++k)
+        snapshot.histogram[k] = mHistogram[k].load(relaxed);
+    snapshot.renderSeconds = mRenderNanoseconds.load(relaxed) * 1e-9;
+    snapshot.deadlineSeconds = mDeadlineNanoseconds.load(relaxed) * 1e-9;
+    snapshot.peakLoad = mPeakLoad.load(relaxed);
+
+    snapshot.activeVoicesCount = mActiveVoicesCount.load(relaxed);
+    snapshot.prunedVoicesCount = mPrunedVoicesCount.load(relaxed);
+    snapshot.decimatedVoicesCount = mDecimatedVoicesCount.load(relaxed);
+    snapshot.queueDepth = mQueueDepth.load(relaxed);
+    snapshot.peakQueueDepth = mPeakQueueDepth.load(relaxed);
+    snapshot.droppedEventsCount = mDroppedEventsCount.load(relaxed);
+    return snapshot;
+}
+
+void RenderStats::reset()
+{
+    mBlocksCount = 0;
+    mDeadlineMissesCount = 0;
+    for (int k = 0; k < HISTOGRAM_BINS; ++k)
+        mHistogram[k] = 0;
+    mRenderNanoseconds = 0;
+    mDeadlineNanoseconds = 0;
+    mPeakLoad = 0.0f;
+    mQueueDepth = 0;
+    mPeakQueueDepth = 0;
+    mDroppedEventsCount = 0;
+}
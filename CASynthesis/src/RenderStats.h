@@ -0,0 +1,92 @@
+//
+//  RenderStats.h
+//  CASynthesis
+//
+//
+
+#ifndef RenderStats_h
+#define RenderStats_h
+
+#include <stdint.h>
+#include <atomic>
+#include <ostream>
+
+// Counters the audio thread publishes once per block for any thread to read. Each is a relaxed atomic with a
+// single writer, so publishing is a handful of stores that never wait; a reader may catch one block's counters
+// half written, which a meter can live with. Render time is measured against the block's own duration, its
+// deadline: a block that took longer than that is a miss, whatever the rest of the audio graph then made of it.
+class RenderStats
+{
+public:
+    static const int HISTOGRAM_BINS = 32;
+    //! histogram bins per deadline, so the bins cover up to twice the deadline and the last one everything over
+    static const int BINS_PER_DEADLINE = 16;
+
+    struct Snapshot
+    {
+        uint64_t blocksCount;
+        uint64_t deadlineMissesCount;
+        uint64_t histogram[HISTOGRAM_BINS];
+        double renderSeconds;
+        double deadlineSeconds;
+        float peakLoad;
+
+        int activeVoicesCount;
+        int prunedVoicesCount;
+        int decimatedVoicesCount;
+        int queueDepth;
+        int peakQueueDepth;
+        uint32_t droppedEventsCount;
+
+        Snapshot();
+
+        //! render time over deadline, all blocks together
+        double getMeanLoad() const;
+        //! the load \a fraction of the blocks stayed under, to the histogram's resolution
+        double getLoadPercentile(double fraction) const;
+
+        //! one "name,value" line per counter, then one per histogram bin named by its lower edge in percent
+        void write(std::ostream& out) const;
+    };
+
+protected:
+    std::atomic<uint64_t> mBlocksCount;
+    std::atomic<uint64_t> mDeadlineMissesCount;
+    std::atomic<uint64_t> mHistogram[HISTOGRAM_BINS];
+    // nanoseconds, so they can be summed in an integer atomic
+    std::atomic<uint64_t> mRenderNanoseconds;
+    std::atomic<uint64_t> mDeadlineNanoseconds;
+    std::atomic<float> mPeakLoad;
+
+    std::atomic<int> mActiveVoicesCount;
+    std::atomic<int> mPrunedVoicesCount;
+    std::atomic<int> mDecimatedVoicesCount;
+    std::atomic<int> mQueueDepth;
+    std::atomic<int> mPeakQueueDepth;
+    std::atomic<uint32_t> mDroppedEventsCount;
+
+public:
+    RenderStats();
+
+    //! audio thread: one rendered block
+    void addBlock(double renderSeconds, double deadlineSeconds);
+    //! audio thread: voices as of the block just rendered
+    void setVoices(int activeCount, int prunedCount, int decimatedCount);
+    //! audio thread: events waiting in the queue when the block drained it
+    void setQueueDepth(int depth);
+    //! the queueing thread: an event lost to a full queue
+    void addDroppedEvent();
+
+    int getActiveVoicesCount() const;
+    int getPrunedVoicesCount() const;
+    int getDecimatedVoicesCount() const;
+    uint32_t getDroppedEventsCount() const;
+
+    Snapshot getSnapshot() const;
+
+    //! clears the totals, histogram and peaks but not the voice counts; a block being published meanwhile may
+    //! survive in part
+    void reset();
+};
+
+#endif /* RenderStats_h */
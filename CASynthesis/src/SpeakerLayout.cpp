@@ -0,0 +1,180 @@
+//
+//  SpeakerLayout.cpp
+//  CASynthesis
+//
+//
+
+#include "SpeakerLayout.h"
+
+#include <math.h>
+#include <algorithm>
+
+const int SpeakerLayout::MAX_BUSES;
+const int SpeakerLayout::MAX_CHANNELS;
+
+SpeakerLayout::SpeakerLayout(Type type)
+{
+    mType = type;
+    mEncoded = false;
+    mFirstAzimuth = 0.0f;
+
+    switch (type)
+    {
+        case LAYOUT_QUAD:
+        {
+            // channels front left, front right, rear left, rear right; the ring visits them clockwise
+            static const int channels[4] = {0, 1, 3, 2};
+            mBusesCount = 4;
+            mChannelsCount = 4;
+            mFirstAzimuth = (float)-M_PI_4;
+            for (int bus = 0; bus < 4; ++bus)
+                mBusChannel[bus] = channels[bus];
+            break;
+        }
+
+        case LAYOUT_RING_8:
+            // speaker one just left of the front, numbered clockwise
+            mBusesCount = 8;
+            mChannelsCount = 8;
+            mFirstAzimuth = (float)(-M_PI / 8.0);
+            for (int bus = 0; bus < 8; ++bus)
+                mBusChannel[bus] = bus;
+            break;
+
+        case LAYOUT_AMBISONIC_FOA:
+            mBusesCount = 8;
+            mChannelsCount = 4;
+            mEncoded = true;
+            for (int bus = 0; bus < 8; ++bus)
+                mBusChannel[bus] = -1;
+            break;
+
+        default:
+            mType = LAYOUT_STEREO;
+            mBusesCount = 2;
+            mChannelsCount = 2;
+            mBusChannel[0] = 0;
+            mBusChannel[1] = 1;
+            break;
+    }
+
+    mBusSpacing = (float)(2.0 * M_PI / mBusesCount);
+
+    for (int channel = 0; channel < MAX_CHANNELS; ++channel)
+        std::fill(mEncoder[channel], mEncoder[channel] + MAX_BUSES, 0.0f);
+    if (mEncoded)
+    {
+        // a plane wave from each virtual speaker; azimuths in AmbiX run anticlockwise
+        for (int bus = 0; bus < mBusesCount; ++bus)
+        {
+            float azimuth = mFirstAzimuth + bus * mBusSpacing;
+            mEncoder[0][bus] = 1.0f;
+            mEncoder[1][bus] = -sinf(azimuth);
+            mEncoder[2][bus] = 0.0f;
+            mEncoder[3][bus] = cosf(azimuth);
+        }
+    }
+}
+
+SpeakerLayout::Type SpeakerLayout::getType() const
+{
+    return mType;
+}
+
+int SpeakerLayout::getBusesCount() const
+{
+    return mBusesCount;
+}
+
+int SpeakerLayout::getChannelsCount() const
+{
+    return mChannelsCount;
+}
+
+int SpeakerLayout::getNextBus(int bus) const
+{
+    return (bus + 1 == mBusesCount) ? 0 : bus + 1;
+}
+
+int SpeakerLayout::getBusChannel(int bus) const
+{
+    return mBusChannel[bus];
+}
+
+bool SpeakerLayout::isEncoded() const
+{
+    return mEncoded;
+}
+
+void SpeakerLayout::encode(const float* const* buses, float* const* channels, size_t frames) const
+{
+    for (int channel = 0; channel < mChannelsCount; ++channel)
+    {
+        float* output = channels[channel];
+        for (int bus = 0; bus < mBusesCount; ++bus)
+        {
+            const float weight = mEncoder[channel][bus];
+            if (weight == 0.0f)
+                continue;
+
+            const float* input = buses[bus];
+            for (size_t k = 0; k < frames; ++k)
+                output[k] += weight * input[k];
+        }
+    }
+}
+
+SpeakerGains SpeakerLayout::getGains(float x, float y) const
+{
+    if (mType == LAYOUT_STEREO)
+        return getPanGains(0.5f * (std::min(std::max(x, -1.0f), 1.0f) + 1.0f));
+
+    // a source right on the centre has no direction, it is put in front
+    float azimuth = (x == 0.0f && y == 0.0f) ? 0.0f : atan2f(x, y);
+    return getPanGains(azimuth / (float)(2.0 * M_PI));
+}
+
+SpeakerGains SpeakerLayout::getPanGains(float pan) const
+{
+    SpeakerGains gains;
+
+    if (mType == LAYOUT_STEREO)
+    {
+        pan = std::min(std::max(pan, 0.0f), 1.0f);
+        gains.bus = 0;
+        gains.first = cosf(pan * (float)M_PI_2);
+        gains.second = sinf(pan * (float)M_PI_2);
+        return gains;
+    }
+
+    // pairwise VBAP: within a pair the gains follow the sines of the angles to the far speaker
+    float position = (pan * (float)(2.0 * M_PI) - mFirstAzimuth) / mBusSpacing;
+    position -= mBusesCount * floorf(position / mBusesCount);
+    int bus = std::min((int)position, mBusesCount - 1);
+    float angle = (position - bus) * mBusSpacing;
+
+    float first = sinf(mBusSpacing - angle);
+    float second = sinf(angle);
+
+    // speakers get constant power; an encoded ring keeps amplitude instead, so W stays level between virtual speakers
+    float norm = mEncoded ? first + second : sqrtf(first * first + second * second);
+    gains.bus = bus;
+    gains.first = first / norm;
+    gains.second = second / norm;
+    return gains;
+}
+
+bool SpeakerLayout::parse(const std::string& name, Type& type)
+{
+    if (name == "stereo")
+        type = LAYOUT_STEREO;
+    else if (name == "quad")
+        type = LAYOUT_QUAD;
+    else if (name == "ring8")
+        type = LAYOUT_RING_8;
+    else if (name == "foa")
+        type = LAYOUT_AMBISONIC_FOA;
+    else
+        return false;
+    return true;
+}
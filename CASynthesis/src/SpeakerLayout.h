@@ -0,0 +1,75 @@
+//
+//  SpeakerLayout.h
+//  CASynthesis
+//
+//
+
+#ifndef SpeakerLayout_h
+#define SpeakerLayout_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+// A source's row of the gain matrix: it only ever feeds two neighbouring buses, \a bus and getNextBus(bus)
+struct SpeakerGains
+{
+    int bus;
+    float first;
+    float second;
+};
+
+// Speaker layouts as a ring of buses the bank pans between pairwise; first order ambisonics pans over a virtual
+// ring of eight encoded to AmbiX (W Y Z X, SN3D).
+class SpeakerLayout
+{
+public:
+    enum Type
+    {
+        LAYOUT_STEREO,
+        LAYOUT_QUAD,
+        LAYOUT_RING_8,
+        LAYOUT_AMBISONIC_FOA
+    };
+
+    static const int MAX_BUSES = 8;
+    static const int MAX_CHANNELS = 8;
+
+protected:
+    Type mType;
+    int mBusesCount;
+    int mChannelsCount;
+    bool mEncoded;
+
+    // buses run clockwise from mFirstAzimuth, in radians clockwise from the front
+    float mFirstAzimuth;
+    float mBusSpacing;
+    int mBusChannel[MAX_BUSES];
+    float mEncoder[MAX_CHANNELS][MAX_BUSES];
+
+public:
+    SpeakerLayout(Type type = LAYOUT_STEREO);
+
+    Type getType() const;
+    int getBusesCount() const;
+    int getChannelsCount() const;
+    int getNextBus(int bus) const;
+
+    //! output channel a bus is written to; only meaningful when the layout is not encoded
+    int getBusChannel(int bus) const;
+
+    //! whether the buses are virtual speakers mixed into the channels by encode()
+    bool isEncoded() const;
+    void encode(const float* const* buses, float* const* channels, size_t frames) const;
+
+    //! \a x to the right and \a y to the front, both -1 to 1
+    SpeakerGains getGains(float x, float y) const;
+
+    //! 0 to 1: left to right in stereo, once round clockwise from the front otherwise
+    SpeakerGains getPanGains(float pan) const;
+
+    //! "stereo", "quad", "ring8" or "foa"
+    static bool parse(const std::string& name, Type& type);
+};
+
+#endif /* SpeakerLayout_h */
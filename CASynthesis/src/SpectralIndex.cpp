@@ -0,0 +1,210 @@
+//
+//  SpectralIndex.cpp
+//  CASynthesis
+//
+//
+
+#include "SpectralIndex.h"
+
+#include <math.h>
+#include <algorithm>
+
+const int SpectralIndex::MAX_NEIGHBORS;
+const int SpectralIndex::MAX_SHIFTED;
+
+SpectralIndex::SpectralIndex()
+{
+    mLowest = 0.0f;
+    mHighest = 1.0f;
+    mRebuild = false;
+}
+
+void SpectralIndex::reset(const float* freqs, int count, float lowestFreq, float highestFreq)
+{
+    mLowest = log2f(lowestFreq);
+    mHighest = log2f(highestFreq);
+
+    mPitch.resize(count);
+    mSortedPitch.resize(count);
+    mSortedId.resize(count);
+    mPosition.resize(count);
+    mScratch.resize(count);
+    mBucketStart.resize(count + 1);
+
+    mPending.clear();
+    mPending.reserve(count);
+    mIsPending.assign(count, false);
+
+    for (int id = 0; id < count; ++id)
+        mPitch[id] = log2f(std::max(freqs[id], lowestFreq));
+
+    rebuild();
+}
+
+void SpectralIndex::update(int id, float freq)
+{
+    mPitch[id] = log2f(std::max(freq, exp2f(mLowest)));
+
+    if (mRebuild || mIsPending[id])
+        return;
+
+    // past this point shifting cells one by one costs more than sorting everything again
+    if (mPending.size() * 16 >= mPitch.size())
+    {
+        mRebuild = true;
+        return;
+    }
+
+    mIsPending[id] = true;
+    mPending.push_back(id);
+}
+
+void SpectralIndex::commit()
+{
+    if (mRebuild)
+    {
+        rebuild();
+    }
+    else if ((int)mPending.size() <= MAX_SHIFTED)
+    {
+        for (size_t k = 0; k < mPending.size(); ++k)
+            move(mPending[k]);
+    }
+    else
+    {
+        merge();
+    }
+
+    for (size_t k = 0; k < mPending.size(); ++k)
+        mIsPending[mPending[k]] = false;
+    mPending.clear();
+    mRebuild = false;
+}
+
+void SpectralIndex::rebuild()
+{
+    // counting sort into one bucket per cell, then a sort per bucket, so a crowded bucket costs m log m
+    const int count = (int)mPitch.size();
+    if (count == 0)
+        return;
+
+    const float scale = count / (mHighest - mLowest);
+    std::fill(mBucketStart.begin(), mBucketStart.end(), 0);
+    for (int id = 0; id < count; ++id)
+    {
+        int bucket = std::min(std::max((int)((mPitch[id] - mLowest) * scale), 0), count - 1);
+        mScratch[id] = bucket;
+        mBucketStart[bucket + 1]++;
+    }
+    for (int bucket = 0; bucket < count; ++bucket)
+        mBucketStart[bucket + 1] += mBucketStart[bucket];
+    for (int id = 0; id < count; ++id)
+        mSortedId[mBucketStart[mScratch[id]]++] = id;
+
+    const std::vector<float>& pitches = mPitch;
+    int begin = 0;
+    for (int bucket = 0; bucket < count; ++bucket)
+    {
+        int end = mBucketStart[bucket];
+        if (end - begin > 1)
+            std::sort(mSortedId.begin() + begin, mSortedId.begin() + end, [&pitches](int a, int b)
+            {
+                return pitches[a] < pitches[b] || (pitches[a] == pitches[b] && a < b);
+            });
+        begin = end;
+    }
+
+    for (int position = 0; position < count; ++position)
+        mSortedPitch[position] = mPitch[mSortedId[position]];
+
+    for (int position = 0; position < count; ++position)
+        mPosition[mSortedId[position]] = position;
+}
+
+void SpectralIndex::merge()
+{
+    // the pending cells are taken out, sorted among themselves and merged back in from the top end
+    const std::vector<float>& pitches = mPitch;
+    std::sort(mPending.begin(), mPending.end(), [&pitches](int a, int b)
+    {
+        return pitches[a] < pitches[b] || (pitches[a] == pitches[b] && a < b);
+    });
+
+    const int count = (int)mSortedId.size();
+    int kept = 0;
+    for (int position = 0; position < count; ++position)
+    {
+        int id = mSortedId[position];
+        if (mIsPending[id])
+            continue;
+        mSortedId[kept] = id;
+        mSortedPitch[kept] = mSortedPitch[position];
+        ++kept;
+    }
+
+    int pending = (int)mPending.size() - 1;
+    for (int position = count - 1; pending >= 0; --position)
+    {
+        int id = mPending[pending];
+        if (kept > 0 && mSortedPitch[kept - 1] > mPitch[id])
+        {
+            --kept;
+            mSortedId[position] = mSortedId[kept];
+            mSortedPitch[position] = mSortedPitch[kept];
+        }
+        else
+        {
+            mSortedId[position] = id;
+            mSortedPitch[position] = mPitch[id];
+            --pending;
+        }
+    }
+
+    for (int position = 0; position < count; ++position)
+        mPosition[mSortedId[position]] = position;
+}
+
+void SpectralIndex::move(int id)
+{
+    const float pitch = mPitch[id];
+    int position = mPosition[id];
+
+    while (position > 0 && mSortedPitch[position - 1] > pitch)
+    {
+        mSortedPitch[position] = mSortedPitch[position - 1];
+        mSortedId[position] = mSortedId[position - 1];
+        mPosition[mSortedId[position]] = position;
+        position--;
+    }
+    while (position + 1 < (int)mSortedPitch.size() && mSortedPitch[position + 1] < pitch)
+    {
+        mSortedPitch[position] = mSortedPitch[position + 1];
+        mSortedId[position] = mSortedId[position + 1];
+        mPosition[mSortedId[position]] = position;
+        position++;
+    }
+
+    mSortedPitch[position] = pitch;
+    mSortedId[position] = id;
+    mPosition[id] = position;
+}
+
+int SpectralIndex::getNearest(int id, int k, int* out) const
+{
+    k = std::min(k, MAX_NEIGHBORS);
+
+    const int count = (int)mSortedPitch.size();
+    const int position = mPosition[id];
+    const float pitch = mSortedPitch[position];
+
+    int left = position - 1;
+    int right = position + 1;
+    int found = 0;
+    while (found < k && (left >= 0 || right < count))
+    {
+        bool takeLeft = (right >= count) || (left >= 0 && pitch - mSortedPitch[left] <= mSortedPitch[right] - pitch);
+        out[found++] = takeLeft ? mSortedId[left--] : mSortedId[right++];
+    }
+
+    return found;
+}
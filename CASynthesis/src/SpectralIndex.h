@@ -0,0 +1,56 @@
+//
+//  SpectralIndex.h
+//  CASynthesis
+//
+//
+
+#ifndef SpectralIndex_h
+#define SpectralIndex_h
+
+#include <vector>
+
+// Cells sorted by log frequency in one contiguous array, so the k nearest neighbours of a cell are
+// a window around its position. Changes are queued by update() and applied by commit(): a few moved
+// cells are shifted into place, more are sorted and merged back in, a generation's worth re-sorts everything.
+class SpectralIndex
+{
+protected:
+    float mLowest;
+    float mHighest;
+
+    std::vector<float> mPitch;
+    std::vector<float> mSortedPitch;
+    std::vector<int> mSortedId;
+    std::vector<int> mPosition;
+
+    std::vector<int> mPending;
+    std::vector<bool> mIsPending;
+    bool mRebuild;
+
+    std::vector<int> mBucketStart;
+    std::vector<int> mScratch;
+
+    // a randomly moved cell shifts across a third of the array on average, so past a few of them one merge pass
+    // over everything is cheaper
+    static const int MAX_SHIFTED = 4;
+
+    void rebuild();
+    void merge();
+    void move(int id);
+
+public:
+    static const int MAX_NEIGHBORS = 32;
+
+    SpectralIndex();
+
+    void reset(const float* freqs, int count, float lowestFreq, float highestFreq);
+
+    void update(int id, float freq);
+    void commit();
+
+    //! writes the ids of the \a k cells nearest to \a id in log frequency to \a out, returns their count;
+    //! only valid after commit()
+    int getNearest(int id, int k, int* out) const;
+};
+
+#endif /* SpectralIndex_h */
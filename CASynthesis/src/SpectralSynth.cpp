@@ -0,0 +1,220 @@
+//
+//  SpectralSynth.cpp
+//  CASynthesis
+//
+//
+
+#include "SpectralSynth.h"
+
+#include <math.h>
+#include <algorithm>
+
+const int SpectralSynth::KERNEL_RADIUS;
+const int SpectralSynth::KERNEL_OVERSAMPLING;
+const int SpectralSynth::MAX_SPECTRA;
+
+static double blackmanHarris(double x)
+{
+    return 0.35875 - 0.48829 * cos(2.0 * M_PI * x) + 0.14128 * cos(4.0 * M_PI * x) - 0.01168 * cos(6.0 * M_PI * x);
+}
+
+SpectralSynth::SpectralSynth(int cellsCount, int voicesCount, double sampleRate, int fftSize)
+: OscillatorBank(cellsCount, voicesCount, sampleRate), mFFT(fftSize)
+{
+    const int size = fftSize;
+    mHopSize = size / 4;
+    setMultirateEnabled(false);
+
+    // transform of the window centred on the frame, sampled finely enough for linear interpolation;
+    // the 1 / size of the inverse transform is folded in here
+    const int kernelSize = 2 * (KERNEL_RADIUS + 1) * KERNEL_OVERSAMPLING + 1;
+    mKernel.resize(kernelSize);
+    for (int k = 0; k < kernelSize; ++k)
+    {
+        double offset = (double)(k - kernelSize / 2) / KERNEL_OVERSAMPLING;
+        double sum = 0.0;
+        for (int n = 0; n < size; ++n)
+            sum += blackmanHarris((double)n / size) * cos(2.0 * M_PI * offset * (n - size / 2) / size);
+        mKernel[k] = (float)(sum / size);
+    }
+
+    // only the middle two hops of a frame are kept: the window is divided out and replaced by a triangle,
+    // and triangles one hop apart sum to one
+    mCorrection.resize(2 * mHopSize);
+    for (int n = 0; n < 2 * mHopSize; ++n)
+    {
+        double triangle = 1.0 - fabs((double)(n - mHopSize) / mHopSize);
+        mCorrection[n] = (float)(triangle / blackmanHarris((double)(n + mHopSize) / size));
+    }
+
+    updateLayout();
+}
+
+void SpectralSynth::updateLayout()
+{
+    const int busesCount = mLayout.getBusesCount();
+    for (int spectrum = 0; spectrum < MAX_SPECTRA; ++spectrum)
+        mSpectrum[spectrum].assign(2 * spectrum < busesCount ? mFFT.getSize() : 0, std::complex<float>(0.0f, 0.0f));
+    for (int bus = 0; bus < SpeakerLayout::MAX_BUSES; ++bus)
+        mOverlap[bus].assign(bus < busesCount ? 2 * mHopSize : 0, 0.0f);
+    mReadPosition = mHopSize;
+}
+
+int SpectralSynth::getFFTSize() const
+{
+    return mFFT.getSize();
+}
+
+int SpectralSynth::getHopSize() const
+{
+    return mHopSize;
+}
+
+size_t SpectralSynth::getLatency() const
+{
+    return mHopSize;
+}
+
+float SpectralSynth::getKernel(float offset) const
+{
+    float position = (offset + (KERNEL_RADIUS + 1)) * KERNEL_OVERSAMPLING;
+    int index = (int)position;
+    float fraction = position - index;
+    return mKernel[index] + (mKernel[index + 1] - mKernel[index]) * fraction;
+}
+
+void SpectralSynth::addVoice(int spectrum, const std::complex<float>& value, const std::complex<float>& pan, float bin)
+{
+    const int mask = mFFT.getSize() - 1;
+    std::complex<float>* bins = &mSpectrum[spectrum][0];
+
+    // two buses share one transform: each is hermitian, so the inverse gives first + i * second
+    const int nearest = (int)floorf(bin + 0.5f);
+    for (int k = nearest - KERNEL_RADIUS; k <= nearest + KERNEL_RADIUS; ++k)
+    {
+        float weight = getKernel(k - bin);
+        // the frame is centred on size / 2, which flips the sign of every odd bin
+        if (k & 1)
+            weight = -weight;
+
+        std::complex<float> positive = value * weight;
+        bins[k & mask] += positive * pan;
+        bins[-k & mask] += std::conj(positive) * pan;
+    }
+}
+
+void SpectralSynth::synthesizeFrame(int64_t centerFrame)
+{
+    const int size = mFFT.getSize();
+    const int busesCount = mLayout.getBusesCount();
+    const int spectraCount = (busesCount + 1) / 2;
+    const float binsPerHz = (float)(size / mSampleRate);
+    const float hopSeconds = (float)(mHopSize / mSampleRate);
+
+    for (int spectrum = 0; spectrum < spectraCount; ++spectrum)
+        std::fill(mSpectrum[spectrum].begin(), mSpectrum[spectrum].end(), std::complex<float>(0.0f, 0.0f));
+    updatePruning();
+
+    const float transposition = mTransposition;
+    skipTransposition(mHopSize);
+    const float nextTransposition = mTransposition;
+
+    for (size_t v = 0; v < mActiveVoices.size(); ++v)
+    {
+        const int voice = mActiveVoices[v];
+        const float previousFreq = mFreq[voice] * transposition;
+        if (mFreqRampFrames[voice] > 0)
+            skipFreqGlide(voice, mHopSize);
+        if (mRampFrames[voice] > 0)
+            skipGainRamp(voice, mHopSize);
+
+        if (mPendingFrame[voice] != NO_PENDING && mPendingFrame[voice] <= centerFrame)
+            applyPending(voice);
+
+        // the phase follows the mean frequency over the hop so that neighbouring frames stay in step
+        const float freq = mFreq[voice] * nextTransposition;
+        float phase = mPhase[voice] + 0.5f * (previousFreq + freq) * hopSeconds;
+        phase -= floorf(phase);
+        mPhase[voice] = phase;
+
+        const float gain = mGain[voice];
+        const float bin = freq * binsPerHz;
+        if (gain == 0.0f || bin >= size / 2 || mPruned[voice])
+            continue;
+
+        // the bank renders sin(2 pi phase) and the kernel describes a cosine, so the angle is a quarter turn back
+        const float amp = 0.5f * gain;
+        const std::complex<float> value(amp * fastsine::sin2pi<fastsine::ACCURACY_HIGH>(phase),
+                                        -amp * fastsine::cos2pi<fastsine::ACCURACY_HIGH>(phase));
+
+        // an even bus is the real part of its pair's spectrum, an odd one the imaginary part
+        const int bus = mVoiceBus[voice];
+        const int nextBus = mLayout.getNextBus(bus);
+        const std::complex<float> first = (bus & 1) ? std::complex<float>(0.0f, mPanFirst[voice]) : std::complex<float>(mPanFirst[voice], 0.0f);
+        const std::complex<float> second = (nextBus & 1) ? std::complex<float>(0.0f, mPanSecond[voice]) : std::complex<float>(mPanSecond[voice], 0.0f);
+        if (bus / 2 == nextBus / 2)
+        {
+            addVoice(bus / 2, value, first + second, bin);
+        }
+        else
+        {
+            addVoice(bus / 2, value, first, bin);
+            addVoice(nextBus / 2, value, second, bin);
+        }
+    }
+
+    for (int spectrum = 0; spectrum < spectraCount; ++spectrum)
+    {
+        mFFT.inverse(&mSpectrum[spectrum][0]);
+
+        float* real = &mOverlap[2 * spectrum][0];
+        float* imag = (2 * spectrum + 1 < busesCount) ? &mOverlap[2 * spectrum + 1][0] : NULL;
+        for (int n = 0; n < 2 * mHopSize; ++n)
+        {
+            const std::complex<float>& sample = mSpectrum[spectrum][n + mHopSize];
+            real[n] += sample.real() * mCorrection[n];
+            if (imag != NULL)
+                imag[n] += sample.imag() * mCorrection[n];
+        }
+    }
+}
+
+void SpectralSynth::releaseStolenVoice(int voice)
+{
+    releaseVoice(voice);
+}
+
+void SpectralSynth::changeVoiceWave(int voice, int wave)
+{
+    mVoiceWave[voice] = (uint8_t)wave;
+}
+
+void SpectralSynth::renderBuses(float* const* buses, size_t frames)
+{
+    const int busesCount = mLayout.getBusesCount();
+    size_t done = 0;
+    while (done < frames)
+    {
+        if (mReadPosition == (size_t)mHopSize)
+        {
+            // the frame starting here crossfades in over this hop and out over the next
+            for (int c = 0; c < busesCount; ++c)
+            {
+                std::copy(mOverlap[c].begin() + mHopSize, mOverlap[c].end(), mOverlap[c].begin());
+                std::fill(mOverlap[c].begin() + mHopSize, mOverlap[c].end(), 0.0f);
+            }
+            synthesizeFrame(mFrame + (int64_t)done + mHopSize);
+            recycleVoices();
+            mReadPosition = 0;
+        }
+
+        size_t count = std::min(frames - done, (size_t)mHopSize - mReadPosition);
+        for (int c = 0; c < busesCount; ++c)
+            for (size_t k = 0; k < count; ++k)
+                buses[c][done + k] += mOverlap[c][mReadPosition + k];
+        mReadPosition += count;
+        done += count;
+    }
+
+    mFrame += (int64_t)frames;
+}
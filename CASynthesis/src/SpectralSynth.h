@@ -0,0 +1,61 @@
+//
+//  SpectralSynth.h
+//  CASynthesis
+//
+//
+
+#ifndef SpectralSynth_h
+#define SpectralSynth_h
+
+#include "OscillatorBank.h"
+#include "FFT.h"
+
+// Inverse FFT additive synthesis (FFT^-1) over the same voice state as OscillatorBank. Every hop each
+// audible voice stamps a few bins of the window's transform into one short-time spectrum, which is
+// brought back with a single inverse FFT and overlap-added with triangular crossfades. Cost per voice
+// is a handful of bins per hop rather than work per sample, so very large grids stay cheap.
+//
+// Voice parameters are sampled once per hop: event frames, ramps and glides are quantised to the hop
+// size, and output runs one hop behind the parameters it renders. Buses are synthesised in pairs, one complex
+// spectrum for two real ones. Wavetables are not drawn on: every voice is its fundamental alone.
+class SpectralSynth : public OscillatorBank
+{
+protected:
+    // Blackman-Harris main lobe half width, in bins; its sidelobes sit below -92 dB
+    static const int KERNEL_RADIUS = 4;
+    static const int KERNEL_OVERSAMPLING = 64;
+
+    FFT mFFT;
+    int mHopSize;
+
+    static const int MAX_SPECTRA = (SpeakerLayout::MAX_BUSES + 1) / 2;
+
+    std::vector<std::complex<float> > mSpectrum[MAX_SPECTRA];
+    std::vector<float> mKernel;
+    std::vector<float> mCorrection;
+    std::vector<float> mOverlap[SpeakerLayout::MAX_BUSES];
+    size_t mReadPosition;
+
+    float getKernel(float offset) const;
+    void addVoice(int spectrum, const std::complex<float>& value, const std::complex<float>& pan, float bin);
+    void synthesizeFrame(int64_t centerFrame);
+
+    void renderBuses(float* const* buses, size_t frames) override;
+    //! frames crossfade over a hop anyway, so a stolen voice needs no copy fading out
+    void releaseStolenVoice(int voice) override;
+    //! every voice plays a sine here, so a change of table changes nothing
+    void changeVoiceWave(int voice, int wave) override;
+    void updateLayout() override;
+
+public:
+    //! \a fftSize is a power of two, hops are a quarter of it
+    SpectralSynth(int cellsCount = 0, int voicesCount = 0, double sampleRate = 44100.0, int fftSize = 1024);
+
+    int getFFTSize() const;
+    int getHopSize() const;
+
+    //! one hop, whatever multirate is set to
+    size_t getLatency() const override;
+};
+
+#endif /* SpectralSynth_h */
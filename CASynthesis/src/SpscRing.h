@@ -0,0 +1,99 @@
+//
+//  SpscRing.h
+//  CASynthesis
+//
+//
+
+#ifndef SpscRing_h
+#define SpscRing_h
+
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+// Wait free single producer, single consumer ring of preallocated slots. push() belongs to one thread and
+// pop() to another; neither ever blocks or allocates. The indices only grow, and the producer and consumer
+// each keep a cached copy of the other's so most calls touch no shared cache line but their own.
+template <typename T>
+class SpscRing
+{
+protected:
+    std::vector<T> mSlots;
+    size_t mMask;
+
+    // producer and consumer indices live on separate cache lines
+    std::atomic<size_t> mWrite;
+    char mWritePadding[64];
+    size_t mCachedRead;
+    char mCachedReadPadding[64];
+    std::atomic<size_t> mRead;
+    char mReadPadding[64];
+    size_t mCachedWrite;
+
+public:
+    //! \a capacity is rounded up to a power of two
+    SpscRing(size_t capacity = 0)
+    {
+        reset(capacity);
+    }
+
+    //! not thread safe: only while neither side is running
+    void reset(size_t capacity)
+    {
+        size_t size = 1;
+        while (size < capacity)
+            size <<= 1;
+
+        mSlots.assign(size, T());
+        mMask = size - 1;
+        mWrite = 0;
+        mRead = 0;
+        mCachedRead = 0;
+        mCachedWrite = 0;
+    }
+
+    size_t getCapacity() const
+    {
+        return mSlots.size();
+    }
+
+    //! approximate from either side
+    size_t getSize() const
+    {
+        return mWrite.load(std::memory_order_acquire) - mRead.load(std::memory_order_acquire);
+    }
+
+    //! producer side; false when the ring is full
+    bool push(const T& value)
+    {
+        size_t write = mWrite.load(std::memory_order_relaxed);
+        if (write - mCachedRead == mSlots.size())
+        {
+            mCachedRead = mRead.load(std::memory_order_acquire);
+            if (write - mCachedRead == mSlots.size())
+                return false;
+        }
+
+        mSlots[write & mMask] = value;
+        mWrite.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    //! consumer side; false when the ring is empty
+    bool pop(T& value)
+    {
+        size_t read = mRead.load(std::memory_order_relaxed);
+        if (read == mCachedWrite)
+        {
+            mCachedWrite = mWrite.load(std::memory_order_acquire);
+            if (read == mCachedWrite)
+                return false;
+        }
+
+        value = mSlots[read & mMask];
+        mRead.store(read + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+#endif /* SpscRing_h */
@@ -0,0 +1,209 @@
+//
+//  WavWriter.cpp
+//  CASynthesis
+//
+//
+
+#include "WavWriter.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+static uint8_t* putU16(uint8_t* out, uint32_t value)
+{
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    return out + 2;
+}
+
+static uint8_t* putU32(uint8_t* out, uint32_t value)
+{
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    out[2] = (uint8_t)(value >> 16);
+    out[3] = (uint8_t)(value >> 24);
+    return out + 4;
+}
+
+static uint8_t* putTag(uint8_t* out, const char* tag)
+{
+    memcpy(out, tag, 4);
+    return out + 4;
+}
+
+WavWriter::WavWriter()
+{
+    mFile = NULL;
+    mFormat = PCM_24;
+    mSampleRate = 0;
+    mChannelsCount = 0;
+    mFramesCount = 0;
+    mClippedCount = 0;
+}
+
+WavWriter::~WavWriter()
+{
+    close();
+}
+
+int WavWriter::getBytesPerSample() const
+{
+    switch (mFormat)
+    {
+        case PCM_16:
+            return 2;
+        case PCM_24:
+            return 3;
+        default:
+            return 4;
+    }
+}
+
+bool WavWriter::writeHeader(uint32_t dataBytes)
+{
+    // float data needs the extended fmt chunk and a fact chunk, more than two channels the extensible one;
+    // stereo PCM gets the plain 44 byte header
+    const bool isFloat = (mFormat == FLOAT_32);
+    const bool isExtensible = (mChannelsCount > 2);
+    const uint32_t fmtBytes = isExtensible ? 40 : (isFloat ? 18 : 16);
+    const uint32_t factBytes = isFloat ? 12 : 0;
+    const uint32_t blockAlign = mChannelsCount * getBytesPerSample();
+    const uint16_t formatTag = isFloat ? 3 : 1;
+
+    uint8_t header[96];
+    uint8_t* out = header;
+    out = putTag(out, "RIFF");
+    out = putU32(out, 4 + (8 + fmtBytes) + factBytes + 8 + dataBytes);
+    out = putTag(out, "WAVE");
+
+    out = putTag(out, "fmt ");
+    out = putU32(out, fmtBytes);
+    out = putU16(out, isExtensible ? 0xfffe : formatTag);
+    out = putU16(out, mChannelsCount);
+    out = putU32(out, (uint32_t)mSampleRate);
+    out = putU32(out, (uint32_t)mSampleRate * blockAlign);
+    out = putU16(out, blockAlign);
+    out = putU16(out, 8 * getBytesPerSample());
+    if (isExtensible)
+    {
+        // valid bits, no channel mask, and the sub format GUID built from the plain tag
+        static const uint8_t guidTail[14] = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71};
+        out = putU16(out, 22);
+        out = putU16(out, 8 * getBytesPerSample());
+        out = putU32(out, 0);
+        out = putU16(out, formatTag);
+        memcpy(out, guidTail, sizeof(guidTail));
+        out += sizeof(guidTail);
+    }
+    else if (isFloat)
+    {
+        out = putU16(out, 0);
+    }
+    if (isFloat)
+    {
+        out = putTag(out, "fact");
+        out = putU32(out, 4);
+        out = putU32(out, dataBytes / blockAlign);
+    }
+
+    out = putTag(out, "data");
+    out = putU32(out, dataBytes);
+
+    const size_t size = out - header;
+    return fseek(mFile, 0, SEEK_SET) == 0 && fwrite(header, 1, size, mFile) == size;
+}
+
+bool WavWriter::open(const std::string& path, int sampleRate, int channelsCount, SampleFormat format)
+{
+    close();
+
+    mFile = fopen(path.c_str(), "wb");
+    if (mFile == NULL)
+        return false;
+
+    mFormat = format;
+    mSampleRate = sampleRate;
+    mChannelsCount = std::max(channelsCount, 1);
+    mFramesCount = 0;
+    mClippedCount = 0;
+
+    if (!writeHeader(0))
+    {
+        fclose(mFile);
+        mFile = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool WavWriter::isOpen() const
+{
+    return mFile != NULL;
+}
+
+bool WavWriter::write(const float* const* channels, size_t frames)
+{
+    if (mFile == NULL)
+        return false;
+
+    const int bytes = getBytesPerSample();
+    mScratch.resize(frames * mChannelsCount * bytes);
+
+    uint8_t* out = mScratch.data();
+    for (size_t k = 0; k < frames; ++k)
+    {
+        for (int c = 0; c < mChannelsCount; ++c)
+        {
+            float sample = channels[c][k];
+            if (mFormat == FLOAT_32)
+            {
+                uint32_t bits;
+                memcpy(&bits, &sample, 4);
+                out = putU32(out, bits);
+                continue;
+            }
+
+            if (sample > 1.0f || sample < -1.0f)
+            {
+                sample = (sample > 0.0f) ? 1.0f : -1.0f;
+                ++mClippedCount;
+            }
+
+            // full scale maps to the largest positive code, so +1 and -1 stay symmetric
+            const float scale = (mFormat == PCM_16) ? 32767.0f : 8388607.0f;
+            const int32_t code = (int32_t)lrintf(sample * scale);
+            out[0] = (uint8_t)code;
+            out[1] = (uint8_t)(code >> 8);
+            if (bytes == 3)
+                out[2] = (uint8_t)(code >> 16);
+            out += bytes;
+        }
+    }
+
+    mFramesCount += frames;
+    return fwrite(mScratch.data(), 1, mScratch.size(), mFile) == mScratch.size();
+}
+
+bool WavWriter::close()
+{
+    if (mFile == NULL)
+        return true;
+
+    // RIFF sizes are 32 bit; anything past 4 GB is still written but the header saturates
+    const uint64_t dataBytes = mFramesCount * mChannelsCount * getBytesPerSample();
+    bool done = writeHeader(dataBytes > 0xffffffffull - 64 ? 0xffffffffu - 64 : (uint32_t)dataBytes);
+    done = (fclose(mFile) == 0) && done;
+    mFile = NULL;
+    return done;
+}
+
+uint64_t WavWriter::getFramesCount() const
+{
+    return mFramesCount;
+}
+
+uint64_t WavWriter::getClippedCount() const
+{
+    return mClippedCount;
+}
@@ -0,0 +1,58 @@
+//
+//  WavWriter.h
+//  CASynthesis
+//
+//
+
+#ifndef WavWriter_h
+#define WavWriter_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Streams float blocks to a RIFF WAVE file as 16 or 24 bit PCM or 32 bit float. The chunk sizes are left at zero
+// until close(), so a file cut short by a crash still opens in most editors. More than two channels are written
+// as WAVE_FORMAT_EXTENSIBLE without speaker positions.
+class WavWriter
+{
+public:
+    enum SampleFormat
+    {
+        PCM_16,
+        PCM_24,
+        FLOAT_32
+    };
+
+protected:
+    FILE* mFile;
+    SampleFormat mFormat;
+    int mSampleRate;
+    int mChannelsCount;
+    uint64_t mFramesCount;
+    uint64_t mClippedCount;
+    std::vector<uint8_t> mScratch;
+
+    int getBytesPerSample() const;
+    bool writeHeader(uint32_t dataBytes);
+
+public:
+    WavWriter();
+    ~WavWriter();
+
+    bool open(const std::string& path, int sampleRate, int channelsCount = 2, SampleFormat format = PCM_24);
+    bool isOpen() const;
+
+    //! interleaves one buffer per channel; PCM samples outside [-1, 1] are clipped and counted
+    bool write(const float* const* channels, size_t frames);
+
+    //! fills in the chunk sizes and closes the file
+    bool close();
+
+    uint64_t getFramesCount() const;
+    uint64_t getClippedCount() const;
+};
+
+#endif /* WavWriter_h */
@@ -0,0 +1,89 @@
+//
+//  Wavetable.cpp
+//  CASynthesis
+//
+//
+
+#include "Wavetable.h"
+#include "FFT.h"
+
+#include <complex>
+#include <algorithm>
+
+const int Wavetable::TABLE_SIZE;
+const int Wavetable::MAX_HARMONICS;
+const int Wavetable::LEVELS;
+
+Wavetable::Wavetable()
+{
+}
+
+Wavetable::Wavetable(Shape shape)
+{
+    std::vector<float> amplitudes(MAX_HARMONICS, 0.0f);
+    for (int h = 1; h <= MAX_HARMONICS; ++h)
+    {
+        if (shape == SHAPE_SAW)
+            amplitudes[h - 1] = 1.0f / h;
+        else if (shape == SHAPE_SQUARE)
+            amplitudes[h - 1] = (h % 2 == 1) ? 1.0f / h : 0.0f;
+    }
+    if (shape == SHAPE_SINE)
+        amplitudes.resize(1, 1.0f);
+    amplitudes[0] = 1.0f;
+
+    setHarmonics(amplitudes.data(), (int)amplitudes.size());
+}
+
+void Wavetable::setHarmonics(const float* amplitudes, int count)
+{
+    mHarmonics.assign(amplitudes, amplitudes + std::min(std::max(count, 0), MAX_HARMONICS));
+    build();
+}
+
+int Wavetable::getHarmonicsCount() const
+{
+    return (int)mHarmonics.size();
+}
+
+bool Wavetable::isEmpty() const
+{
+    return mSamples.empty();
+}
+
+void Wavetable::build()
+{
+    mSamples.clear();
+    if (mHarmonics.empty())
+        return;
+
+    FFT fft(TABLE_SIZE);
+    std::vector<std::complex<float> > spectrum(TABLE_SIZE);
+    mSamples.assign(LEVELS * (TABLE_SIZE + 1), 0.0f);
+
+    float peak = 0.0f;
+    for (int level = 0; level < LEVELS; ++level)
+    {
+        // a sine partial of amplitude a is -a/2 i at its bin and the conjugate at the mirror, the inverse being unscaled
+        std::fill(spectrum.begin(), spectrum.end(), std::complex<float>(0.0f, 0.0f));
+        const int count = std::min(1 << level, (int)mHarmonics.size());
+        for (int h = 1; h <= count; ++h)
+        {
+            spectrum[h] = std::complex<float>(0.0f, -0.5f * mHarmonics[h - 1]);
+            spectrum[TABLE_SIZE - h] = std::complex<float>(0.0f, 0.5f * mHarmonics[h - 1]);
+        }
+        fft.inverse(spectrum.data());
+
+        float* samples = &mSamples[level * (TABLE_SIZE + 1)];
+        for (int k = 0; k < TABLE_SIZE; ++k)
+        {
+            samples[k] = spectrum[k].real();
+            peak = std::max(peak, fabsf(samples[k]));
+        }
+        samples[TABLE_SIZE] = samples[0];
+    }
+
+    if (peak > 0.0f)
+        for (size_t k = 0; k < mSamples.size(); ++k)
+            mSamples[k] /= peak;
+}
@@ -0,0 +1,76 @@
+//
+//  Wavetable.h
+//  CASynthesis
+//
+//
+
+#ifndef Wavetable_h
+#define Wavetable_h
+
+#include <math.h>
+#include <vector>
+
+// One period of a harmonic waveform, kept band limited by a mipmap of one table per octave: level l holds the
+// first 2^l harmonics, so a fundamental of up to 1 / 2^(l+1) cycles per sample reads it without a single
+// partial above Nyquist. The levels depend on frequency relative to the sample rate only, so a table serves any
+// rate. Tables are built by inverse FFT from the harmonic amplitudes, all in sine phase, and scaled by one factor
+// for every level so no level peaks above 1 and the loudness does not jump from one octave to the next.
+class Wavetable
+{
+public:
+    enum Shape
+    {
+        SHAPE_SINE,
+        SHAPE_SAW,
+        SHAPE_SQUARE
+    };
+
+    static const int TABLE_SIZE = 4096;
+    //! four samples to the period of the highest harmonic keep linear interpolation clean
+    static const int MAX_HARMONICS = TABLE_SIZE / 4;
+    //! 1 to MAX_HARMONICS harmonics, reaching the full band down to 1 / 2048 of the sample rate
+    static const int LEVELS = 11;
+
+protected:
+    std::vector<float> mHarmonics;
+    // LEVELS tables of TABLE_SIZE + 1 samples, the last one repeating the first for interpolation
+    std::vector<float> mSamples;
+
+    void build();
+
+public:
+    //! an empty table, which the bank plays as a plain sine
+    Wavetable();
+    Wavetable(Shape shape);
+
+    //! amplitudes of harmonics 1 to \a count, at most MAX_HARMONICS; allocates and builds every level
+    void setHarmonics(const float* amplitudes, int count);
+    int getHarmonicsCount() const;
+    bool isEmpty() const;
+
+    //! the level to read a fundamental of \a increment cycles per sample from
+    static int getLevel(float increment)
+    {
+        int exponent;
+        frexpf(increment, &exponent);
+        int level = -exponent - 1;
+        return (level < 0) ? 0 : (level >= LEVELS ? LEVELS - 1 : level);
+    }
+
+    const float* getSamples(int level) const
+    {
+        return &mSamples[level * (TABLE_SIZE + 1)];
+    }
+
+    //! linear interpolation at \a phase, 0 to 1
+    static float lookup(const float* samples, float phase)
+    {
+        float position = phase * TABLE_SIZE;
+        int index = (int)position;
+        float fraction = position - index;
+        index &= TABLE_SIZE - 1;
+        return samples[index] + fraction * (samples[index + 1] - samples[index]);
+    }
+};
+
+#endif /* Wavetable_h */
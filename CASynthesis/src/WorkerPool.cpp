@@ -0,0 +1,151 @@
+//
+//  WorkerPool.cpp
+//  CASynthesis
+//
+//
+
+#include "WorkerPool.h"
+
+#include <chrono>
+
+#if defined(__APPLE__)
+#include <pthread.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPU_RELAX() _mm_pause()
+#else
+#define CPU_RELAX() std::this_thread::yield()
+#endif
+
+const int WorkerPool::YIELD_INTERVAL;
+
+WorkerPool::WorkerPool(int threadsCount)
+: mGeneration(0), mRemaining(0), mParked(0), mQuit(false), mSpinNanoseconds(0), mJob(nullptr), mContext(nullptr), mRealtime(false)
+{
+    resize(threadsCount);
+}
+
+WorkerPool::~WorkerPool()
+{
+    stop();
+}
+
+void WorkerPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+    }
+    mWake.notify_all();
+
+    for (size_t k = 0; k < mThreads.size(); ++k)
+        mThreads[k].join();
+    mThreads.clear();
+    mQuit = false;
+}
+
+void WorkerPool::resize(int threadsCount)
+{
+    stop();
+
+    // workers start from the current generation, so a run() issued before they get going is not missed
+    for (int index = 1; index < threadsCount; ++index)
+        mThreads.push_back(std::thread(&WorkerPool::work, this, index, mGeneration.load()));
+}
+
+int WorkerPool::getThreadsCount() const
+{
+    return (int)mThreads.size() + 1;
+}
+
+void WorkerPool::setSpinTime(double seconds)
+{
+    mSpinNanoseconds = (int64_t)(seconds * 1e9);
+}
+
+double WorkerPool::getSpinTime() const
+{
+    return mSpinNanoseconds.load() * 1e-9;
+}
+
+void WorkerPool::work(int index, uint32_t seen)
+{
+#if defined(__APPLE__)
+    pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+#endif
+
+    while (true)
+    {
+        // the occasional yield keeps spinning workers from starving the audio thread on a busy machine
+        const std::chrono::nanoseconds spin(mSpinNanoseconds.load());
+        const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + spin;
+        int spins = 0;
+        while (spin.count() > 0 && mGeneration.load() == seen && !mQuit)
+        {
+            if ((++spins & (YIELD_INTERVAL - 1)) != 0)
+                CPU_RELAX();
+            else if (std::chrono::steady_clock::now() < deadline)
+                std::this_thread::yield();
+            else
+                break;
+        }
+
+        if (mGeneration.load() == seen && !mQuit)
+        {
+            // parked is raised before the last look at the generation, and run() bumps the generation
+            // before looking at parked, so one of the two always sees the other
+            std::unique_lock<std::mutex> lock(mMutex);
+            ++mParked;
+            mWake.wait(lock, [&] { return mGeneration.load() != seen || mQuit; });
+            --mParked;
+        }
+
+        if (mQuit)
+            return;
+
+        seen = mGeneration.load();
+        {
+            RealtimeGuard::Scope scope(mRealtime);
+            mJob(mContext, index);
+        }
+        --mRemaining;
+    }
+}
+
+void WorkerPool::run(Job job, void* context)
+{
+    if (mThreads.empty())
+    {
+        job(context, 0);
+        return;
+    }
+
+    mJob = job;
+    mContext = context;
+    mRealtime = RealtimeGuard::isRealtimeThread();
+    mRemaining = (int)mThreads.size();
+    ++mGeneration;
+
+    if (mParked.load() > 0)
+    {
+        // taking the lock once orders the wake up after any worker that is about to wait; workers only hold it
+        // for the few instructions before they wait, so it is bounded
+        {
+            RealtimeGuard::Allow allow;
+            std::lock_guard<std::mutex> lock(mMutex);
+        }
+        mWake.notify_all();
+    }
+
+    job(context, 0);
+
+    for (int spins = 1; mRemaining.load() > 0; ++spins)
+    {
+        if ((spins & (YIELD_INTERVAL - 1)) == 0)
+            std::this_thread::yield();
+        else
+            CPU_RELAX();
+    }
+}
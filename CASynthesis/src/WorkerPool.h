@@ -0,0 +1,65 @@
+//
+//  WorkerPool.h
+//  CASynthesis
+//
+//
+
+#ifndef WorkerPool_h
+#define WorkerPool_h
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <stdint.h>
+
+#include "RealtimeGuard.h"
+
+// Persistent worker threads for the audio callback. run() hands every worker the same job with its own
+// index, does index 0 on the calling thread and returns once all are done; the join is a single atomic
+// counter. Idle workers spin for up to getSpinTime() before parking on a condition variable, so back to back
+// audio blocks can restart them without a wake up; by default they park at once.
+class WorkerPool
+{
+public:
+    typedef void (*Job)(void* context, int index);
+
+protected:
+    std::vector<std::thread> mThreads;
+
+    std::atomic<uint32_t> mGeneration;
+    std::atomic<int> mRemaining;
+    std::atomic<int> mParked;
+    std::atomic<bool> mQuit;
+    std::atomic<int64_t> mSpinNanoseconds;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+
+    Job mJob;
+    void* mContext;
+    // workers run the job under the caller's RealtimeGuard scope
+    bool mRealtime;
+
+    void work(int index, uint32_t seen);
+    void stop();
+
+public:
+    //! spinning threads yield, and look at the clock, once every this many pauses, a power of two
+    static const int YIELD_INTERVAL = 256;
+
+    WorkerPool(int threadsCount = 1);
+    ~WorkerPool();
+
+    //! total threads including the caller of run(); not to be called while run() is in progress
+    void resize(int threadsCount);
+    int getThreadsCount() const;
+
+    //! how long an idle worker waits for the next run() before parking, 0 to park at once; any thread
+    void setSpinTime(double seconds);
+    double getSpinTime() const;
+
+    void run(Job job, void* context);
+};
+
+#endif /* WorkerPool_h */
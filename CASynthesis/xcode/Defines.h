@@ -14,4 +14,20 @@
 #define BASE_FREQ 50.0
 #define HARMONIX_MAX 10
 
+#define CONTROL_GRID_SIZE 8
+#define CONTROL_STEP_FRAMES 48
+
+#define TRANSPOSE_GLIDE_TIME 0.25
+
+#define WAVE_SINE 0
+#define WAVE_SAW 1
+#define WAVE_SQUARE 2
+#define WAVE_AUTOMATON 3
+
+#define ASYNC_MAX_RATE (1.0 / STEP_TIME)
+
+#define SPECTRAL_NEIGHBORS 8
+
+#define BANK_MAX_THREADS 4
+
 #endif /* Defines_h */